@@ -0,0 +1,190 @@
+/* Measure the time to set up a long pipeline with libspawn, stage by
+   stage as cush used to versus with posix_spawn_pipeline_np.
+
+   Stage 0 runs /bin/true and every further stage runs /bin/cat, so the
+   pipeline drains as soon as it has been created.  Each run counts the
+   stages that did not end up in the process group of the first one (a
+   setpgid from the parent fails once the child has exec'ed) and the
+   descriptors leaked in the parent.
+
+   Usage: pipeline_bench [-s stages] [-r runs]
+     -s stages  number of stages per pipeline (default 64)
+     -r runs    number of pipelines per method (default 50)  */
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static char *true_argv[] = { "true", NULL };
+static char *cat_argv[] = { "cat", NULL };
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static int
+count_fds (void)
+{
+  DIR *d = opendir ("/proc/self/fd");
+  int n = 0;
+  while (readdir (d) != NULL)
+    n++;
+  closedir (d);
+  return n;
+}
+
+/* One stage at a time: a pipe and a file actions object per stage, and
+   setpgid from the parent for every stage after the first.  */
+static void
+spawn_stagewise (pid_t *pids, int nstages)
+{
+  int prev = -1;
+  for (int i = 0; i < nstages; i++)
+    {
+      int fds[2] = { -1, -1 };
+      posix_spawn_file_actions_t fa;
+      posix_spawnattr_t attr;
+
+      posix_spawn_file_actions_init (&fa);
+      posix_spawnattr_init (&attr);
+      posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETPGROUP);
+      if (i + 1 < nstages)
+	{
+	  pipe2 (fds, O_CLOEXEC);
+	  posix_spawn_file_actions_adddup2 (&fa, fds[1], STDOUT_FILENO);
+	}
+      if (prev != -1)
+	posix_spawn_file_actions_adddup2 (&fa, prev, STDIN_FILENO);
+
+      if (posix_spawnp (&pids[i], i == 0 ? "/bin/true" : "/bin/cat", &fa,
+			&attr, i == 0 ? true_argv : cat_argv, environ) != 0)
+	{
+	  perror ("posix_spawnp");
+	  exit (EXIT_FAILURE);
+	}
+      setpgid (pids[i], pids[0]);
+
+      if (prev != -1)
+	close (prev);
+      if (fds[1] != -1)
+	close (fds[1]);
+      prev = fds[0];
+      posix_spawn_file_actions_destroy (&fa);
+      posix_spawnattr_destroy (&attr);
+    }
+}
+
+/* All stages in one call.  */
+static void
+spawn_pipeline (pid_t *pids, int nstages)
+{
+  struct posix_spawn_stage *stages = calloc (nstages, sizeof *stages);
+  posix_spawnattr_t attr;
+
+  for (int i = 0; i < nstages; i++)
+    {
+      stages[i].file = i == 0 ? "/bin/true" : "/bin/cat";
+      stages[i].argv = i == 0 ? true_argv : cat_argv;
+    }
+  posix_spawnattr_init (&attr);
+  posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETPGROUP);
+  if (posix_spawn_pipeline_np (pids, NULL, nstages, stages, &attr,
+			       environ) != 0)
+    {
+      perror ("posix_spawn_pipeline_np");
+      exit (EXIT_FAILURE);
+    }
+  posix_spawnattr_destroy (&attr);
+  free (stages);
+}
+
+/* Run one pipeline, returning the time taken to spawn it.  Counts the
+   stages that ended up outside the first stage's group in *STRAYS and
+   the descriptors left open in *LEAKS.  */
+static double
+run (void (*spawn) (pid_t *, int), int nstages, int *strays, int *leaks)
+{
+  pid_t *pids = calloc (nstages, sizeof *pids);
+  int fds = count_fds ();
+
+  double t = now ();
+  spawn (pids, nstages);
+  t = now () - t;
+
+  /* Unreaped children keep their process group, even if they exited.  */
+  for (int i = 0; i < nstages; i++)
+    if (getpgid (pids[i]) != pids[0])
+      ++*strays;
+  *leaks += count_fds () - fds;
+
+  for (int i = 0; i < nstages; i++)
+    waitpid (pids[i], NULL, 0);
+  free (pids);
+  return t;
+}
+
+static void
+report (const char *name, double *t, int runs, int nstages, int strays,
+	int leaks)
+{
+  qsort (t, runs, sizeof *t, cmp_double);
+  printf ("%-24s p50 %8.2f ms  %6.1f us/stage  %d stages outside group, "
+	  "%d fds leaked\n", name, t[runs / 2] * 1e3,
+	  t[runs / 2] * 1e6 / nstages, strays, leaks);
+}
+
+int
+main (int ac, char *av[])
+{
+  int nstages = 64, runs = 50;
+  int opt;
+
+  while ((opt = getopt (ac, av, "s:r:")) > 0)
+    switch (opt)
+      {
+      case 's':
+	nstages = atoi (optarg);
+	break;
+      case 'r':
+	runs = atoi (optarg);
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-s stages] [-r runs]\n", av[0]);
+	return EXIT_FAILURE;
+      }
+
+  double *t[2] = { calloc (runs, sizeof (double)),
+		   calloc (runs, sizeof (double)) };
+  int strays[2] = { 0, 0 }, leaks[2] = { 0, 0 };
+
+  /* Alternate so that changes in machine load affect both equally.  */
+  for (int r = 0; r < runs; r++)
+    {
+      t[0][r] = run (spawn_stagewise, nstages, &strays[0], &leaks[0]);
+      t[1][r] = run (spawn_pipeline, nstages, &strays[1], &leaks[1]);
+    }
+
+  printf ("%d stages, %d runs\n", nstages, runs);
+  report ("stage by stage", t[0], runs, nstages, strays[0], leaks[0]);
+  report ("posix_spawn_pipeline_np", t[1], runs, nstages, strays[1],
+	  leaks[1]);
+  return EXIT_SUCCESS;
+}
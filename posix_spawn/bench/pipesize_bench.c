@@ -0,0 +1,170 @@
+/* Measure the throughput of a three-stage pipeline for several pipe
+   capacities set through posix_spawn_stage.pipe_size, and with the
+   capacity grown on demand by posix_spawn_pipe_grow_np.
+
+   The pipeline is 'head -c BYTES /dev/zero | cat | cat > /dev/null'.
+   In the adaptive run the pipes start at the default size and are
+   sampled every 10 ms, as cush does for 'pipesize auto'.
+
+   Usage: pipesize_bench [-b bytes] [-r runs]
+     -b bytes   bytes pushed through each pipeline (default 1 GiB)
+     -r runs    pipelines per setting (default 3)  */
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define NSTAGES 3
+#define ADAPTIVE (-1)
+
+extern char **environ;
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static int
+pipe_max_size (void)
+{
+  int size = 1048576;
+  FILE *f = fopen ("/proc/sys/fs/pipe-max-size", "r");
+  if (f != NULL)
+    {
+      if (fscanf (f, "%d", &size) != 1)
+	size = 1048576;
+      fclose (f);
+    }
+  return size;
+}
+
+/* Push BYTES through the pipeline with pipes of PIPE_SIZE bytes (0 for
+   the default, ADAPTIVE to grow them while it runs).  Returns the time
+   taken; counts the pipes grown in *GROWN.  */
+static double
+run (long long bytes, int pipe_size, int max_size, int *grown)
+{
+  char count[32];
+  snprintf (count, sizeof count, "%lld", bytes);
+  char *head_argv[] = { "head", "-c", count, "/dev/zero", NULL };
+  char *cat_argv[] = { "cat", NULL };
+  posix_spawn_file_actions_t sink;
+  struct posix_spawn_stage stages[NSTAGES] = {
+    { "head", head_argv, NULL, NULL, 0 },
+    { "cat", cat_argv, NULL, NULL, 0 },
+    { "cat", cat_argv, &sink, NULL, 0 },
+  };
+  pid_t pids[NSTAGES];
+  int pidfds[NSTAGES];
+
+  posix_spawn_file_actions_init (&sink);
+  posix_spawn_file_actions_addopen (&sink, STDOUT_FILENO, "/dev/null",
+				    O_WRONLY, 0);
+  for (int i = 0; i + 1 < NSTAGES; i++)
+    stages[i].pipe_size = pipe_size > 0 ? pipe_size : 0;
+
+  double t = now ();
+  int ret = posix_spawn_pipeline_np (pids, pidfds, NSTAGES, stages, NULL,
+				     environ);
+  if (ret != 0)
+    {
+      errno = ret;
+      perror ("posix_spawn_pipeline_np");
+      exit (EXIT_FAILURE);
+    }
+
+  if (pipe_size == ADAPTIVE)
+    {
+      struct pollfd last = { pidfds[NSTAGES - 1], POLLIN, 0 };
+      int sizes[NSTAGES] = { 0 };
+      while (poll (&last, 1, 10) == 0)
+	for (int i = 1; i < NSTAGES; i++)
+	  {
+	    int size;
+	    if (posix_spawn_pipe_grow_np (pidfds[i], STDIN_FILENO, max_size,
+					  &size) == 0)
+	      {
+		if (sizes[i] != 0 && size > sizes[i])
+		  ++*grown;
+		sizes[i] = size;
+	      }
+	  }
+    }
+
+  for (int i = 0; i < NSTAGES; i++)
+    {
+      waitpid (pids[i], NULL, 0);
+      close (pidfds[i]);
+    }
+  t = now () - t;
+  posix_spawn_file_actions_destroy (&sink);
+  return t;
+}
+
+int
+main (int ac, char *av[])
+{
+  long long bytes = 1LL << 30;
+  int runs = 3;
+  int opt;
+
+  while ((opt = getopt (ac, av, "b:r:")) > 0)
+    switch (opt)
+      {
+      case 'b':
+	bytes = atoll (optarg);
+	break;
+      case 'r':
+	runs = atoi (optarg);
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-b bytes] [-r runs]\n", av[0]);
+	return EXIT_FAILURE;
+      }
+
+  int max_size = pipe_max_size ();
+  int settings[] = { 0, 16384, 262144, max_size, ADAPTIVE };
+  int nsettings = sizeof settings / sizeof settings[0];
+  double *t = calloc (runs, sizeof *t);
+
+  printf ("%d stages, %lld bytes, %d runs, pipe-max-size %d\n", NSTAGES,
+	  bytes, runs, max_size);
+  for (int s = 0; s < nsettings; s++)
+    {
+      int grown = 0;
+      for (int r = 0; r < runs; r++)
+	t[r] = run (bytes, settings[s], max_size, &grown);
+      qsort (t, runs, sizeof *t, cmp_double);
+
+      char name[32];
+      if (settings[s] == 0)
+	snprintf (name, sizeof name, "default");
+      else if (settings[s] == ADAPTIVE)
+	snprintf (name, sizeof name, "adaptive");
+      else
+	snprintf (name, sizeof name, "%d KiB", settings[s] / 1024);
+      printf ("%-10s p50 %8.3f s  %6.2f GB/s", name, t[runs / 2],
+	      bytes / t[runs / 2] * 1e-9);
+      if (settings[s] == ADAPTIVE)
+	printf ("  %.1f pipes grown per run", (double) grown / runs);
+      printf ("\n");
+    }
+  free (t);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/* Measure the cost of posix_spawnp in libspawn with and without
+   posix_spawn_signal_handled_np.
+
+   Without it, the child inspects and resets every signal before exec;
+   with it, the child only resets the signals recorded as handled.
+   Recording cannot be undone, so the untracked configuration runs
+   first, after a warm-up round.
+
+   Usage: sighandled_bench [-n count]
+     -n count   number of spawns per configuration (default 10000)  */
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Spawn /bin/true COUNT times, storing the latency of each
+   posix_spawnp call in LAT.  */
+static void
+run (int count, double *lat)
+{
+  char *argv[] = { "true", NULL };
+
+  for (int i = 0; i < count; i++)
+    {
+      pid_t pid;
+      int status;
+      double t = now ();
+      if (posix_spawnp (&pid, "/bin/true", NULL, NULL, argv, environ) != 0)
+	{
+	  perror ("posix_spawnp");
+	  exit (EXIT_FAILURE);
+	}
+      lat[i] = now () - t;
+      waitpid (pid, &status, 0);
+    }
+}
+
+static void
+report (const char *name, double *lat, int count)
+{
+  qsort (lat, count, sizeof *lat, cmp_double);
+  printf ("%-20s p50 %7.1f us  p99 %7.1f us\n", name,
+	  lat[count / 2] * 1e6, lat[count * 99 / 100] * 1e6);
+}
+
+static void
+handler (int sig)
+{
+}
+
+int
+main (int ac, char *av[])
+{
+  int count = 10000;
+  int opt;
+
+  while ((opt = getopt (ac, av, "n:")) > 0)
+    switch (opt)
+      {
+      case 'n':
+	count = atoi (optarg);
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-n count]\n", av[0]);
+	return EXIT_FAILURE;
+      }
+
+  double *lat = calloc (count, sizeof (double));
+
+  /* A typical shell has a SIGCHLD handler installed.  */
+  signal (SIGCHLD, handler);
+
+  run (count / 10, lat);
+  run (count, lat);
+  report ("sweep all signals", lat, count);
+
+  posix_spawn_signal_handled_np (SIGCHLD, 1);
+  run (count, lat);
+  report ("handled signals only", lat, count);
+  return EXIT_SUCCESS;
+}
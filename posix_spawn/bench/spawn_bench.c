@@ -0,0 +1,235 @@
+/* Spawn latency of libspawn compared to glibc's posix_spawn, vfork+exec
+   and fork+exec.
+
+   Every case spawns /bin/true N times, once with a short argv and once
+   with about 1 MiB of arguments, and waits for each child before
+   starting the next.  The latency of one iteration is the time from the
+   spawn call until waitpid returns, so that methods that return before
+   the exec (fork) are measured on equal terms.
+
+   The tcsetpgrp case is only run if standard input is a terminal.
+
+   Usage: spawn_bench [-n count] [-c]
+     -n count   spawns per case (default 2000)
+     -c         print CSV instead of a table  */
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define BIG_ARGS 1024		/* 1024 arguments of 1 KiB each */
+#define BIG_ARG_SIZE 1024
+
+extern char **environ;
+
+typedef int (*posix_spawn_fn) (pid_t *, const char *,
+			       const posix_spawn_file_actions_t *,
+			       const posix_spawnattr_t *, char *const[],
+			       char *const[]);
+
+enum method { LIBSPAWN, GLIBC, VFORK, FORK };
+
+struct bench_case
+{
+  const char *name;
+  enum method method;
+  short flags;			/* posix_spawnattr flags */
+  bool file_actions;		/* redirect to /dev/null and closefrom */
+  bool needs_tty;
+};
+
+static const struct bench_case cases[] = {
+  { "libspawn", LIBSPAWN, 0, false, false },
+  { "libspawn usevfork", LIBSPAWN, POSIX_SPAWN_USEVFORK, false, false },
+  { "libspawn setpgroup", LIBSPAWN, POSIX_SPAWN_SETPGROUP, false, false },
+  { "libspawn tcsetpgrp", LIBSPAWN,
+    POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_TCSETPGROUP, false, true },
+  { "libspawn file actions", LIBSPAWN, 0, true, false },
+  { "glibc", GLIBC, 0, false, false },
+  { "glibc setpgroup", GLIBC, POSIX_SPAWN_SETPGROUP, false, false },
+  { "glibc file actions", GLIBC, 0, true, false },
+  { "vfork+exec", VFORK, 0, false, false },
+  { "fork+exec", FORK, 0, false, false },
+};
+
+static posix_spawn_fn glibc_posix_spawn;
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static pid_t
+spawn_one (const struct bench_case *c, char *const argv[],
+	   const posix_spawn_file_actions_t *fa,
+	   const posix_spawnattr_t *attr)
+{
+  pid_t pid = -1;
+  int ret = 0;
+
+  switch (c->method)
+    {
+    case LIBSPAWN:
+      ret = posix_spawn (&pid, "/bin/true", fa, attr, argv, environ);
+      break;
+    case GLIBC:
+      ret = glibc_posix_spawn (&pid, "/bin/true", fa, attr, argv, environ);
+      break;
+    case VFORK:
+      pid = vfork ();
+      if (pid == 0)
+	{
+	  execve ("/bin/true", argv, environ);
+	  _exit (127);
+	}
+      ret = pid == -1 ? errno : 0;
+      break;
+    case FORK:
+      pid = fork ();
+      if (pid == 0)
+	{
+	  execve ("/bin/true", argv, environ);
+	  _exit (127);
+	}
+      ret = pid == -1 ? errno : 0;
+      break;
+    }
+  if (ret != 0)
+    {
+      fprintf (stderr, "%s: %s\n", c->name, strerror (ret));
+      exit (EXIT_FAILURE);
+    }
+  return pid;
+}
+
+/* Run one case COUNT times; store the latencies in LAT and return the
+   total time.  */
+static double
+run (const struct bench_case *c, char *const argv[], int count, double *lat)
+{
+  posix_spawn_file_actions_t fa;
+  posix_spawnattr_t attr;
+
+  posix_spawn_file_actions_init (&fa);
+  if (c->file_actions)
+    {
+      posix_spawn_file_actions_addopen (&fa, STDOUT_FILENO, "/dev/null",
+					O_WRONLY, 0);
+      posix_spawn_file_actions_adddup2 (&fa, STDOUT_FILENO, STDERR_FILENO);
+      posix_spawn_file_actions_addclosefrom_np (&fa, STDERR_FILENO + 1);
+    }
+  posix_spawnattr_init (&attr);
+  posix_spawnattr_setflags (&attr, c->flags);
+
+  double start = now ();
+  for (int i = 0; i < count; i++)
+    {
+      double t = now ();
+      pid_t pid = spawn_one (c, argv, &fa, &attr);
+      waitpid (pid, NULL, 0);
+      lat[i] = now () - t;
+    }
+  double total = now () - start;
+
+  /* Children that took the terminal leave us in the background.  */
+  if (c->flags & POSIX_SPAWN_TCSETPGROUP)
+    tcsetpgrp (STDIN_FILENO, getpgrp ());
+
+  posix_spawn_file_actions_destroy (&fa);
+  posix_spawnattr_destroy (&attr);
+  return total;
+}
+
+int
+main (int ac, char *av[])
+{
+  int count = 2000;
+  bool csv = false;
+  int opt;
+
+  while ((opt = getopt (ac, av, "n:c")) > 0)
+    switch (opt)
+      {
+      case 'n':
+	count = atoi (optarg);
+	break;
+      case 'c':
+	csv = true;
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-n count] [-c]\n", av[0]);
+	return EXIT_FAILURE;
+      }
+
+  /* libspawn's posix_spawn shadows glibc's in this program.  */
+  glibc_posix_spawn = (posix_spawn_fn) dlsym (RTLD_NEXT, "posix_spawn");
+  if (glibc_posix_spawn == NULL)
+    {
+      fprintf (stderr, "cannot find glibc's posix_spawn: %s\n", dlerror ());
+      return EXIT_FAILURE;
+    }
+
+  /* A child that takes the terminal makes us a background process.  */
+  signal (SIGTTOU, SIG_IGN);
+  bool tty = isatty (STDIN_FILENO);
+
+  char *small_argv[] = { "true", NULL };
+  char **big_argv = calloc (BIG_ARGS + 2, sizeof (char *));
+  char *big_arg = malloc (BIG_ARG_SIZE);
+  memset (big_arg, 'x', BIG_ARG_SIZE - 1);
+  big_arg[BIG_ARG_SIZE - 1] = '\0';
+  big_argv[0] = "true";
+  for (int i = 1; i <= BIG_ARGS; i++)
+    big_argv[i] = big_arg;
+
+  struct
+  {
+    const char *name;
+    char **argv;
+  } argvs[] = { { "small", small_argv }, { "1MiB", big_argv } };
+
+  double *lat = calloc (count, sizeof (double));
+  if (csv)
+    printf ("method,argv,count,p50_us,p99_us,spawns_per_sec\n");
+  else
+    printf ("%-24s %-6s %10s %10s %12s\n", "method", "argv", "p50 us",
+	    "p99 us", "spawns/sec");
+
+  for (size_t a = 0; a < sizeof argvs / sizeof argvs[0]; a++)
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+      {
+	const struct bench_case *c = &cases[i];
+	if (c->needs_tty && !tty)
+	  continue;
+
+	double total = run (c, argvs[a].argv, count, lat);
+	qsort (lat, count, sizeof *lat, cmp_double);
+	double p50 = lat[count / 2] * 1e6, p99 = lat[count * 99 / 100] * 1e6;
+	if (csv)
+	  printf ("%s,%s,%d,%.1f,%.1f,%.0f\n", c->name, argvs[a].name, count,
+		  p50, p99, count / total);
+	else
+	  printf ("%-24s %-6s %10.1f %10.1f %12.0f\n", c->name, argvs[a].name,
+		  p50, p99, count / total);
+      }
+  return EXIT_SUCCESS;
+}
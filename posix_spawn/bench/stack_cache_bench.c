@@ -0,0 +1,132 @@
+/* Measure the cost of posix_spawnp in libspawn with and without the
+   child stack cache.
+
+   Both configurations are run in alternating rounds so that drift in
+   machine load affects them equally.  The latency reported is the time
+   the parent spends inside posix_spawnp, which ends when the child has
+   called execve; waiting for the child to exit is not included.
+
+   Usage: stack_cache_bench [-n count] [-t]
+     -n count   number of spawns per configuration (default 10000)
+     -t         keep a second thread spinning, so that unmapping a
+                stack has to shoot down the TLB of another CPU.  */
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define ROUNDS 20
+
+extern char **environ;
+
+static volatile bool done;
+
+static void *
+spin (void *arg)
+{
+  while (!done)
+    ;
+  return NULL;
+}
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Spawn /bin/true COUNT times, one at a time, storing the latency of
+   each call in LAT.  Returns the total time including the waits.  */
+static double
+run (int count, double *lat)
+{
+  char *argv[] = { "true", NULL };
+  double start = now ();
+
+  for (int i = 0; i < count; i++)
+    {
+      pid_t pid;
+      int status;
+      double t = now ();
+      if (posix_spawnp (&pid, "/bin/true", NULL, NULL, argv, environ) != 0)
+	{
+	  perror ("posix_spawnp");
+	  exit (EXIT_FAILURE);
+	}
+      lat[i] = now () - t;
+      waitpid (pid, &status, 0);
+    }
+  return now () - start;
+}
+
+static void
+report (const char *name, double *lat, int count, double total)
+{
+  qsort (lat, count, sizeof *lat, cmp_double);
+  printf ("%-16s p50 %7.1f us  p99 %7.1f us  %8.0f spawns/sec\n", name,
+	  lat[count / 2] * 1e6, lat[count * 99 / 100] * 1e6, count / total);
+}
+
+int
+main (int ac, char *av[])
+{
+  int count = 10000;
+  bool threaded = false;
+  int opt;
+  pthread_t spinner;
+
+  while ((opt = getopt (ac, av, "n:t")) > 0)
+    switch (opt)
+      {
+      case 'n':
+	count = atoi (optarg);
+	break;
+      case 't':
+	threaded = true;
+	break;
+      default:
+	fprintf (stderr, "Usage: %s [-n count] [-t]\n", av[0]);
+	return EXIT_FAILURE;
+      }
+
+  int per_round = count / ROUNDS;
+  count = per_round * ROUNDS;
+  double *lat[2] = { calloc (count, sizeof (double)),
+		     calloc (count, sizeof (double)) };
+  double total[2] = { 0, 0 };
+  int cached = posix_spawn_stack_cache_np (0);
+
+  if (threaded)
+    pthread_create (&spinner, NULL, spin, NULL);
+
+  for (int r = 0; r < ROUNDS; r++)
+    for (int mode = 0; mode < 2; mode++)
+      {
+	posix_spawn_stack_cache_np (mode ? cached : 0);
+	total[mode] += run (per_round, lat[mode] + r * per_round);
+      }
+
+  report ("mmap per spawn", lat[0], count, total[0]);
+  report ("stack cache", lat[1], count, total[1]);
+
+  if (threaded)
+    {
+      done = true;
+      pthread_join (spinner, NULL);
+    }
+  return EXIT_SUCCESS;
+}
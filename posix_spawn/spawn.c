@@ -23,3 +23,27 @@ int posix_spawnp(pid_t *pid, const char *file,
     return __spawni(pid, file, file_actions, attrp, argv, envp, SPAWN_XFLAGS_USE_PATH);
 }
 
+int posix_spawn(pid_t *pid, const char *path,
+                const posix_spawn_file_actions_t *file_actions,
+                const posix_spawnattr_t *attrp,
+                char *const argv[], char *const envp[])
+{
+    return __spawni(pid, path, file_actions, attrp, argv, envp, 0);
+}
+
+int posix_spawn_pidfd_np(int *pidfd, pid_t *pid, const char *path,
+                const posix_spawn_file_actions_t *file_actions,
+                const posix_spawnattr_t *attrp,
+                char *const argv[], char *const envp[])
+{
+    return __spawni_ext(pid, pidfd, NULL, path, file_actions, attrp, argv, envp, 0);
+}
+
+int posix_spawnp_pidfd_np(int *pidfd, pid_t *pid, const char *file,
+                const posix_spawn_file_actions_t *file_actions,
+                const posix_spawnattr_t *attrp,
+                char *const argv[], char *const envp[])
+{
+    return __spawni_ext(pid, pidfd, NULL, file, file_actions, attrp, argv, envp,
+                        SPAWN_XFLAGS_USE_PATH);
+}
@@ -23,8 +23,13 @@
 #include <sched.h>
 #include <sys/types.h>
 #include <bits/types/sigset_t.h>
+#ifdef __USE_GNU
+# include <sys/resource.h>
+#endif
 
 
+struct posix_spawn_rlimit;
+
 /* Data structure to contain attributes for thread creation.  */
 typedef struct
 {
@@ -35,7 +40,16 @@ typedef struct
   struct sched_param __sp;
   int __policy;
   int __tcpgrp;
-  int __pad[15];
+  int __xflags;
+  int __mempolicy;
+  size_t __cpusetsize;
+  const void *__cpuset;
+  unsigned long int __maxnode;
+  const unsigned long int *__nodemask;
+  const struct posix_spawn_rlimit *__rlimits;
+  int __nrlimits;
+  short int __ioprio;
+  short int __nice;
 } posix_spawnattr_t;
 
 
@@ -179,6 +193,154 @@ extern int posix_spawnattr_tcsetpgrp_np (posix_spawnattr_t *__attr, int fd)
 extern int posix_spawnattr_tcgetpgrp_np (const posix_spawnattr_t *
 					 __restrict __attr, int *fd)
      __THROW __nonnull ((1, 2));
+
+/* Restrict the spawned process to the CPUs in CPUSET, which is
+   CPUSETSIZE bytes long, as if by sched_setaffinity.  The set is not
+   copied and must stay valid as long as ATTR is used.  A null CPUSET
+   removes the restriction again.  */
+extern int posix_spawnattr_setaffinity_np (posix_spawnattr_t *__attr,
+					   size_t __cpusetsize,
+					   const cpu_set_t *__cpuset)
+     __THROW __nonnull ((1));
+
+/* Return the CPU set stored in ATTR, or a null pointer if there is
+   none.  */
+extern int posix_spawnattr_getaffinity_np (const posix_spawnattr_t *
+					   __restrict __attr,
+					   size_t *__restrict __cpusetsize,
+					   const cpu_set_t **__restrict __cpuset)
+     __THROW __nonnull ((1, 2, 3));
+
+/* Give the spawned process the NUMA memory policy MODE (one of the
+   MPOL_* constants of <linux/mempolicy.h>) over the nodes in NODEMASK,
+   a bit mask of MAXNODE bits, as if by set_mempolicy.  The mask is not
+   copied and must stay valid as long as ATTR is used.  */
+extern int posix_spawnattr_setmempolicy_np (posix_spawnattr_t *__attr,
+					    int __mode,
+					    const unsigned long int *__nodemask,
+					    unsigned long int __maxnode)
+     __THROW __nonnull ((1));
+
+/* Forget the memory policy stored in ATTR.  */
+extern int posix_spawnattr_clearmempolicy_np (posix_spawnattr_t *__attr)
+     __THROW __nonnull ((1));
+
+/* A resource limit for posix_spawnattr_setrlimits_np.  */
+struct posix_spawn_rlimit
+{
+  int resource;
+  struct rlimit limit;
+};
+
+/* Set the NLIMITS resource limits in LIMITS in the spawned process, as
+   if by setrlimit, in order.  The array is not copied and must stay
+   valid as long as ATTR is used.  NLIMITS 0 sets none.  */
+extern int posix_spawnattr_setrlimits_np (posix_spawnattr_t *__attr,
+					  const struct posix_spawn_rlimit *
+					  __limits, size_t __nlimits)
+     __THROW __nonnull ((1));
+
+/* Give the spawned process the I/O priority IOPRIO, a class and level
+   combined as by IOPRIO_PRIO_VALUE from <linux/ioprio.h>, as if by
+   ioprio_set.  */
+extern int posix_spawnattr_setioprio_np (posix_spawnattr_t *__attr,
+					 int __ioprio)
+     __THROW __nonnull ((1));
+
+/* Let the spawned process inherit the I/O priority again.  */
+extern int posix_spawnattr_clearioprio_np (posix_spawnattr_t *__attr)
+     __THROW __nonnull ((1));
+
+/* Give the spawned process the nice value NICE (not an increment), as
+   if by setpriority.  */
+extern int posix_spawnattr_setnice_np (posix_spawnattr_t *__attr, int __nice)
+     __THROW __nonnull ((1));
+
+/* Let the spawned process inherit the nice value again.  */
+extern int posix_spawnattr_clearnice_np (posix_spawnattr_t *__attr)
+     __THROW __nonnull ((1));
+
+/* Keep at most NSTACKS child stacks mapped between spawn calls for reuse
+   (0 disables the cache) and release any beyond that.  Returns the
+   previous limit, or -1 if NSTACKS is out of range.  */
+extern int posix_spawn_stack_cache_np (int __nstacks) __THROW;
+
+/* Record whether a handler is installed for SIG (HANDLED nonzero) or
+   not.  After the first call, spawned children reset only the signals
+   recorded here to SIG_DFL rather than inspecting every signal, so the
+   caller must record every handler it installs (and clear the record
+   when it restores SIG_DFL or SIG_IGN).  */
+extern int posix_spawn_signal_handled_np (int __sig, int __handled) __THROW;
+
+/* Like posix_spawn and posix_spawnp, but also store in *PIDFD a file
+   descriptor referring to the new process, created atomically with it
+   (see pidfd_open).  The descriptor is close-on-exec.  Returns ENOSYS
+   if the kernel does not support CLONE_PIDFD.  If no descriptor is
+   left for it, the process is still spawned and *PIDFD is set to -1.  */
+extern int posix_spawn_pidfd_np (int *__restrict __pidfd,
+				 pid_t *__restrict __pid,
+				 const char *__restrict __path,
+				 const posix_spawn_file_actions_t *__file_actions,
+				 const posix_spawnattr_t *__restrict __attrp,
+				 char *const __argv[__restrict_arr],
+				 char *const __envp[__restrict_arr])
+     __nonnull ((1, 3, 6));
+
+extern int posix_spawnp_pidfd_np (int *__restrict __pidfd,
+				  pid_t *__restrict __pid,
+				  const char *__restrict __file,
+				  const posix_spawn_file_actions_t *__file_actions,
+				  const posix_spawnattr_t *__restrict __attrp,
+				  char *const __argv[__restrict_arr],
+				  char *const __envp[__restrict_arr])
+     __nonnull ((1, 3, 6));
+
+/* One command of a pipeline for posix_spawn_pipeline_np.  FILE is
+   searched for on PATH unless it contains a slash.  FILE_ACTIONS may be
+   NULL; they run after the stage's pipes have been connected.  */
+struct posix_spawn_stage
+{
+  const char *file;
+  char *const *argv;
+  const posix_spawn_file_actions_t *file_actions;
+  /* If not NULL, the CPU affinity, memory policy, resource limits, I/O
+     priority and nice value set in ATTR replace those of the pipeline's
+     attributes for this stage.  */
+  const posix_spawnattr_t *attr;
+  /* Capacity in bytes of the pipe to the next stage, or 0 for the
+     system's default.  Set with F_SETPIPE_SZ as far as the kernel
+     permits; the pipe keeps its default size otherwise.  */
+  int pipe_size;
+};
+
+/* Spawn NSTAGES commands connected by pipes, the standard output of each
+   feeding the standard input of the next.  All pipes are created before
+   the first stage is spawned and the parent's ends are closed as soon as
+   the stage using them has been spawned.  Every stage is spawned with
+   ATTRP; if it requests POSIX_SPAWN_SETPGROUP, the first stage that is
+   spawned successfully leads the group (unless ATTRP names another one)
+   and the others join it before they exec, and only that stage performs
+   POSIX_SPAWN_TCSETPGROUP.
+
+   The pid of stage I is stored in PIDS[I], or the negated error number if
+   it could not be spawned; if PIDFDS is not NULL, a pidfd for it (or -1)
+   is stored in PIDFDS[I].  Returns 0 if all stages were spawned, else
+   the error of the first one that failed.  */
+extern int posix_spawn_pipeline_np (pid_t *__pids, int *__pidfds,
+				    size_t __nstages,
+				    const struct posix_spawn_stage *__stages,
+				    const posix_spawnattr_t *__restrict __attrp,
+				    char *const __envp[__restrict_arr])
+     __nonnull ((1, 4));
+
+/* Look at the pipe open as descriptor FD in the process referred to by
+   PIDFD (such as the standard input of a pipeline stage).  If it is
+   full, so that whoever writes to it is blocked, double its capacity,
+   up to MAX_SIZE bytes.  Stores the resulting capacity in *SIZE.  Meant
+   to be called periodically while a pipeline runs.  */
+extern int posix_spawn_pipe_grow_np (int __pidfd, int __fd, int __max_size,
+				     int *__size)
+     __THROW __nonnull ((4));
 #endif
 
 /* Initialize data structure for file attribute for `spawn' call.  */
@@ -227,6 +389,13 @@ extern int posix_spawn_file_actions_addchdir_np (posix_spawn_file_actions_t *
 extern int posix_spawn_file_actions_addfchdir_np (posix_spawn_file_actions_t *,
 						  int __fd)
      __THROW __nonnull ((1));
+
+/* Add an action to close all file descriptors greater than or equal to
+   FROM during spawn.  This affects the subsequent file actions.  */
+extern int
+posix_spawn_file_actions_addclosefrom_np (posix_spawn_file_actions_t *,
+					  int __from)
+     __THROW __nonnull ((1));
 #endif
 
 __END_DECLS
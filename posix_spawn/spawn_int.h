@@ -32,6 +32,7 @@ struct __spawn_action
     spawn_do_open,
     spawn_do_chdir,
     spawn_do_fchdir,
+    spawn_do_closefrom,
   } tag;
 
   union
@@ -60,12 +61,21 @@ struct __spawn_action
     {
       int fd;
     } fchdir_action;
+    struct
+    {
+      int from;
+    } closefrom_action;
   } action;
 };
 
 #define SPAWN_XFLAGS_USE_PATH	0x1
 #define SPAWN_XFLAGS_TRY_SHELL	0x2
 
+/* Bits in the __xflags member of posix_spawnattr_t.  */
+#define SPAWN_XATTR_MEMPOLICY	0x1	/* __mempolicy and __nodemask are set.  */
+#define SPAWN_XATTR_IOPRIO	0x2	/* __ioprio is set.  */
+#define SPAWN_XATTR_NICE	0x4	/* __nice is set.  */
+
 extern int __posix_spawn_file_actions_realloc (posix_spawn_file_actions_t *
 					       file_actions);
 
@@ -74,6 +84,18 @@ extern int __spawni (pid_t *pid, const char *path,
 		     const posix_spawnattr_t *attrp, char *const argv[],
 		     char *const envp[], int xflags);
 
+extern int __spawni_ext (pid_t *pid, int *pidfd, const int stdio[2],
+			 const char *path,
+			 const posix_spawn_file_actions_t *file_actions,
+			 const posix_spawnattr_t *attrp, char *const argv[],
+			 char *const envp[], int xflags);
+
+/* Signals registered with posix_spawn_signal_handled_np.  Once
+   __spawn_handled_tracked is set, the child resets only these (and the
+   POSIX_SPAWN_SETSIGDEF set) instead of querying every signal.  */
+extern sigset_t __spawn_handled_signals;
+extern bool __spawn_handled_tracked;
+
 /* Return true if FD falls into the range valid for file descriptors.
    The check in this form is mandated by POSIX.  */
 bool __spawn_valid_fd (int fd);
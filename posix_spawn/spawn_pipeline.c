@@ -0,0 +1,186 @@
+/* Spawn a pipeline of commands.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "spawn_int.h"
+
+#ifndef SYS_pidfd_getfd
+# define SYS_pidfd_getfd 438	/* the same on every architecture */
+#endif
+
+/* Replace the per-process settings in ATTR, those that do not concern
+   the pipeline as a whole, by the ones in STAGE_ATTR.  */
+static void
+set_stage_attr (posix_spawnattr_t *attr, const posix_spawnattr_t *stage_attr)
+{
+  const int xflags = (SPAWN_XATTR_MEMPOLICY | SPAWN_XATTR_IOPRIO
+		      | SPAWN_XATTR_NICE);
+
+  attr->__cpuset = stage_attr->__cpuset;
+  attr->__cpusetsize = stage_attr->__cpusetsize;
+  attr->__mempolicy = stage_attr->__mempolicy;
+  attr->__nodemask = stage_attr->__nodemask;
+  attr->__maxnode = stage_attr->__maxnode;
+  attr->__rlimits = stage_attr->__rlimits;
+  attr->__nrlimits = stage_attr->__nrlimits;
+  attr->__ioprio = stage_attr->__ioprio;
+  attr->__nice = stage_attr->__nice;
+  attr->__xflags = (attr->__xflags & ~xflags) | (stage_attr->__xflags & xflags);
+}
+
+/* Report all NSTAGES stages as not spawned because of error EC.  */
+static int
+fail_stages (pid_t *pids, int *pidfds, size_t nstages, int ec)
+{
+  for (size_t i = 0; i < nstages; i++)
+    {
+      pids[i] = -ec;
+      if (pidfds != NULL)
+	pidfds[i] = -1;
+    }
+  return ec;
+}
+
+int
+posix_spawn_pipeline_np (pid_t *pids, int *pidfds, size_t nstages,
+			 const struct posix_spawn_stage *stages,
+			 const posix_spawnattr_t *attrp, char *const envp[])
+{
+  if (nstages == 0)
+    return EINVAL;
+
+  /* Pipe I connects stage I to stage I + 1.  All of them are close-on-exec,
+     so a stage inherits only the two ends dup'ed onto its standard input
+     and output.  */
+  size_t npipes = nstages - 1;
+  int (*pipes)[2] = NULL;
+  if (npipes > 0)
+    {
+      pipes = malloc (npipes * sizeof *pipes);
+      if (pipes == NULL)
+	return fail_stages (pids, pidfds, nstages, ENOMEM);
+      for (size_t i = 0; i < npipes; i++)
+	{
+	  if (pipe2 (pipes[i], O_CLOEXEC) != 0)
+	    {
+	      int ec = errno;
+	      while (i-- > 0)
+		{
+		  close (pipes[i][0]);
+		  close (pipes[i][1]);
+		}
+	      free (pipes);
+	      return fail_stages (pids, pidfds, nstages, ec);
+	    }
+	  /* Best effort, see struct posix_spawn_stage.  */
+	  if (stages[i].pipe_size > 0)
+	    fcntl (pipes[i][1], F_SETPIPE_SZ, stages[i].pipe_size);
+	}
+    }
+
+  posix_spawnattr_t attr;
+  if (attrp != NULL)
+    attr = *attrp;
+  else
+    memset (&attr, 0, sizeof attr);
+  bool have_leader = false;
+
+  int ec = 0;
+  for (size_t i = 0; i < nstages; i++)
+    {
+      int stdio[2] = { i > 0 ? pipes[i - 1][0] : -1,
+		       i < npipes ? pipes[i][1] : -1 };
+      int *pidfd = pidfds != NULL ? &pidfds[i] : NULL;
+
+      posix_spawnattr_t stage_attr = attr;
+      if (stages[i].attr != NULL)
+	set_stage_attr (&stage_attr, stages[i].attr);
+
+      int ret = __spawni_ext (&pids[i], pidfd, stdio, stages[i].file,
+			      stages[i].file_actions, &stage_attr,
+			      stages[i].argv, envp, SPAWN_XFLAGS_USE_PATH);
+      if (ret != 0)
+	{
+	  pids[i] = -ret;
+	  if (pidfds != NULL)
+	    pidfds[i] = -1;
+	  if (ec == 0)
+	    ec = ret;
+	}
+      else if (!have_leader && (attr.__flags & POSIX_SPAWN_SETPGROUP) != 0)
+	{
+	  /* The remaining stages join this one's group from within the
+	     child, so the parent never has to call setpgid, and the group
+	     already owns the terminal.  */
+	  if (attr.__pgrp == 0)
+	    attr.__pgrp = pids[i];
+	  attr.__flags &= ~POSIX_SPAWN_TCSETPGROUP;
+	  have_leader = true;
+	}
+
+      /* Stage I was the last user of these pipe ends.  */
+      if (i > 0)
+	close (pipes[i - 1][0]);
+      if (i < npipes)
+	close (pipes[i][1]);
+    }
+
+  free (pipes);
+  return ec;
+}
+
+int
+posix_spawn_pipe_grow_np (int pidfd, int fd, int max_size, int *size)
+{
+  int pipefd = syscall (SYS_pidfd_getfd, pidfd, fd, 0);
+  if (pipefd < 0)
+    return errno;
+
+  int ec = 0;
+  int capacity = fcntl (pipefd, F_GETPIPE_SZ);
+  int queued;
+  if (capacity < 0 || ioctl (pipefd, FIONREAD, &queued) != 0)
+    ec = errno;
+  else
+    {
+      /* The pipe is full once it has no page left for the writer.  */
+      if (queued > capacity - getpagesize () && capacity < max_size)
+	{
+	  int new_size = capacity <= max_size / 2 ? 2 * capacity : max_size;
+	  int ret = fcntl (pipefd, F_SETPIPE_SZ, new_size);
+	  if (ret < 0)
+	    ec = errno;
+	  else
+	    capacity = ret;
+	}
+      *size = capacity;
+    }
+
+  /* Holding on to the pipe would keep the writer from getting SIGPIPE
+     once the reader is gone, so let go at once.  */
+  close (pipefd);
+  return ec;
+}
@@ -0,0 +1,43 @@
+/* Set the CPU affinity of spawned processes.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <spawn.h>
+
+int
+posix_spawnattr_setaffinity_np (posix_spawnattr_t *attr, size_t cpusetsize,
+				const cpu_set_t *cpuset)
+{
+  if (cpuset != NULL && cpusetsize == 0)
+    return EINVAL;
+
+  attr->__cpuset = cpuset;
+  attr->__cpusetsize = cpuset != NULL ? cpusetsize : 0;
+  return 0;
+}
+
+int
+posix_spawnattr_getaffinity_np (const posix_spawnattr_t *attr,
+				size_t *cpusetsize, const cpu_set_t **cpuset)
+{
+  *cpuset = attr->__cpuset;
+  *cpusetsize = attr->__cpusetsize;
+  return 0;
+}
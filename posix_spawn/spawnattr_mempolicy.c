@@ -0,0 +1,49 @@
+/* Set the NUMA memory policy of spawned processes.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <spawn.h>
+#include "spawn_int.h"
+
+int
+posix_spawnattr_setmempolicy_np (posix_spawnattr_t *attr, int mode,
+				 const unsigned long int *nodemask,
+				 unsigned long int maxnode)
+{
+  /* The kernel checks MODE and the nodes; it does so in the child, where
+     a failure is reported as the error of the spawn call.  */
+  if (mode < 0 || (nodemask == NULL && maxnode != 0))
+    return EINVAL;
+
+  attr->__mempolicy = mode;
+  attr->__nodemask = nodemask;
+  attr->__maxnode = maxnode;
+  attr->__xflags |= SPAWN_XATTR_MEMPOLICY;
+  return 0;
+}
+
+int
+posix_spawnattr_clearmempolicy_np (posix_spawnattr_t *attr)
+{
+  attr->__mempolicy = 0;
+  attr->__nodemask = NULL;
+  attr->__maxnode = 0;
+  attr->__xflags &= ~SPAWN_XATTR_MEMPOLICY;
+  return 0;
+}
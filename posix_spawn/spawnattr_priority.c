@@ -0,0 +1,62 @@
+/* Set the I/O priority and nice value of spawned processes.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+#include "spawn_int.h"
+
+int
+posix_spawnattr_setioprio_np (posix_spawnattr_t *attr, int ioprio)
+{
+  /* Sixteen bits hold every class and level the kernel knows.  */
+  if (ioprio < 0 || ioprio > 0xffff)
+    return EINVAL;
+
+  attr->__ioprio = ioprio;
+  attr->__xflags |= SPAWN_XATTR_IOPRIO;
+  return 0;
+}
+
+int
+posix_spawnattr_clearioprio_np (posix_spawnattr_t *attr)
+{
+  attr->__ioprio = 0;
+  attr->__xflags &= ~SPAWN_XATTR_IOPRIO;
+  return 0;
+}
+
+int
+posix_spawnattr_setnice_np (posix_spawnattr_t *attr, int nice)
+{
+  if (nice < -NZERO || nice >= NZERO)
+    return EINVAL;
+
+  attr->__nice = nice;
+  attr->__xflags |= SPAWN_XATTR_NICE;
+  return 0;
+}
+
+int
+posix_spawnattr_clearnice_np (posix_spawnattr_t *attr)
+{
+  attr->__nice = 0;
+  attr->__xflags &= ~SPAWN_XATTR_NICE;
+  return 0;
+}
@@ -0,0 +1,40 @@
+/* Set resource limits of spawned processes.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+
+int
+posix_spawnattr_setrlimits_np (posix_spawnattr_t *attr,
+			       const struct posix_spawn_rlimit *limits,
+			       size_t nlimits)
+{
+  if (nlimits > INT_MAX || (limits == NULL && nlimits != 0))
+    return EINVAL;
+
+  for (size_t i = 0; i < nlimits; i++)
+    if (limits[i].resource < 0 || limits[i].resource >= RLIM_NLIMITS
+	|| limits[i].limit.rlim_cur > limits[i].limit.rlim_max)
+      return EINVAL;
+
+  attr->__rlimits = nlimits != 0 ? limits : NULL;
+  attr->__nrlimits = nlimits;
+  return 0;
+}
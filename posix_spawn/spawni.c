@@ -26,6 +26,7 @@
 #include <sys/wait.h>
 #include <sys/param.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 //#include <not-cancel.h>
 //#include <local-setxid.h>
 //#include <shlib-compat.h>
@@ -50,11 +51,25 @@
 #define __getrlimit64 getrlimit64
 #define __open_nocancel open
 #define __fcntl fcntl
+#ifndef SYS_close_range
+# define SYS_close_range 436	/* the same on every architecture */
+#endif
+#define __close_range(__fd, __maxfd, __flags) \
+  syscall (SYS_close_range, __fd, __maxfd, __flags)
+#define __sched_setaffinity sched_setaffinity
+#define __set_mempolicy(__mode, __nodemask, __maxnode) \
+  syscall (SYS_set_mempolicy, __mode, __nodemask, __maxnode)
+#define __setrlimit setrlimit
+#define __setpriority setpriority
+#define IOPRIO_WHO_PROCESS 1
+#define __ioprio_set(__which, __who, __ioprio) \
+  syscall (SYS_ioprio_set, __which, __who, __ioprio)
 #define __fchdir fchdir
 #define __setsid setsid
 #define __waitpid waitpid
 #define __munmap munmap
 #define __mmap mmap
+#define __madvise madvise
 #define __execve execve
 #define __chdir chdir
 #define __dup2 dup2
@@ -134,11 +149,11 @@ _Static_assert (sizeof (posix_spawnattr_t) == 336,
 #define SPAWN_ERROR	127
 
 #ifdef __ia64__
-# define CLONE(__fn, __stackbase, __stacksize, __flags, __args) \
-  __clone2 (__fn, __stackbase, __stacksize, __flags, __args, 0, 0, 0)
+# define CLONE(__fn, __stackbase, __stacksize, __flags, __args, __ptid) \
+  __clone2 (__fn, __stackbase, __stacksize, __flags, __args, __ptid, 0, 0)
 #else
-# define CLONE(__fn, __stack, __stacksize, __flags, __args) \
-  __clone (__fn, __stack, __flags, __args)
+# define CLONE(__fn, __stack, __stacksize, __flags, __args, __ptid) \
+  __clone (__fn, __stack, __flags, __args, __ptid)
 #endif
 
 /* Since ia64 wants the stackbase w/clone2, re-use the grows-up macro.  */
@@ -160,6 +175,7 @@ struct posix_spawn_args
   ptrdiff_t argc;
   char *const *envp;
   int xflags;
+  const int *stdio;
   int err;
 };
 
@@ -203,7 +219,10 @@ __spawni_child (void *arguments)
      SIG_IGN.  It does by iterating over all signals and although it could
      possibly be more optimized (by tracking which signal potentially have a
      signal handler), it might requires system specific solutions (since the
-     sigset_t data type can be very different on different architectures).  */
+     sigset_t data type can be very different on different architectures).
+     If the application records its handlers with
+     posix_spawn_signal_handled_np, only those signals are reset and the
+     per-signal sigaction query is skipped.  */
   struct sigaction sa;
   memset (&sa, '\0', sizeof (sa));
 
@@ -220,6 +239,12 @@ __spawni_child (void *arguments)
 	{
 	  if (__is_internal_signal (sig))
 	    sa.sa_handler = SIG_IGN;
+	  else if (__spawn_handled_tracked)
+	    {
+	      if (!__sigismember (&__spawn_handled_signals, sig))
+		continue;
+	      sa.sa_handler = SIG_DFL;
+	    }
 	  else
 	    {
 	      __libc_sigaction (sig, 0, &sa);
@@ -249,6 +274,32 @@ __spawni_child (void *arguments)
     }
 #endif
 
+  /* Place the child on its CPUs and memory nodes before it execs, so
+     that the new image never runs or allocates anywhere else.  */
+  if (attr->__cpuset != NULL
+      && __sched_setaffinity (0, attr->__cpusetsize, attr->__cpuset) != 0)
+    goto fail;
+
+  if ((attr->__xflags & SPAWN_XATTR_MEMPOLICY) != 0
+      && __set_mempolicy (attr->__mempolicy, attr->__nodemask,
+			  attr->__maxnode) != 0)
+    goto fail;
+
+  /* Limits and priorities also take effect before the exec.  Lowering a
+     hard limit or the priority cannot be undone by the new image.  */
+  for (int i = 0; i < attr->__nrlimits; i++)
+    if (__setrlimit (attr->__rlimits[i].resource,
+		     &attr->__rlimits[i].limit) != 0)
+      goto fail;
+
+  if ((attr->__xflags & SPAWN_XATTR_IOPRIO) != 0
+      && __ioprio_set (IOPRIO_WHO_PROCESS, 0, attr->__ioprio) != 0)
+    goto fail;
+
+  if ((attr->__xflags & SPAWN_XATTR_NICE) != 0
+      && __setpriority (PRIO_PROCESS, 0, attr->__nice) != 0)
+    goto fail;
+
   if ((attr->__flags & POSIX_SPAWN_SETSID) != 0
       && __setsid () < 0)
     goto fail;
@@ -275,6 +326,25 @@ __spawni_child (void *arguments)
 	  || local_setegid (__getgid ()) != 0))
     goto fail;
 
+  /* Connect standard input and output to the pipes of a pipeline stage
+     (see posix_spawn_pipeline_np) before any file actions run, so that
+     redirections of the stage override them.  */
+  if (args->stdio != NULL)
+    for (int fd = 0; fd < 2; fd++)
+      {
+	if (args->stdio[fd] == -1)
+	  continue;
+	if (args->stdio[fd] == fd)
+	  {
+	    int flags = __fcntl (fd, F_GETFD, 0);
+	    if (flags == -1
+		|| __fcntl (fd, F_SETFD, flags & ~FD_CLOEXEC) == -1)
+	      goto fail;
+	  }
+	else if (__dup2 (args->stdio[fd], fd) != fd)
+	  goto fail;
+      }
+
   /* Execute the file actions.  */
   if (file_actions != 0)
     {
@@ -365,6 +435,27 @@ __spawni_child (void *arguments)
 	      if (__fchdir (action->action.fchdir_action.fd) != 0)
 		goto fail;
 	      break;
+
+	    case spawn_do_closefrom:
+	      {
+		/* One close_range covers every descriptor, however many the
+		   parent has open.  Before Linux 5.9, close them one by one
+		   up to the descriptor limit.  */
+		int lowfd = action->action.closefrom_action.from;
+		if (__close_range (lowfd, ~0U, 0) != 0)
+		  {
+		    if (errno != ENOSYS)
+		      goto fail;
+		    if (!have_fdlimit)
+		      {
+			__getrlimit64 (RLIMIT_NOFILE, &fdlimit);
+			have_fdlimit = true;
+		      }
+		    for (int fd = lowfd; fd < fdlimit.rlim_cur; fd++)
+		      __close_nocancel (fd);
+		  }
+	      }
+	      break;
 	    }
 	}
     }
@@ -391,16 +482,133 @@ fail:
   _exit (SPAWN_ERROR);
 }
 
+/* Mapping a fresh stack for every child and unmapping it afterwards costs
+   two VMA changes (and, in a multi-threaded parent, a TLB shootdown) per
+   spawn.  Instead, up to STACK_CACHE.MAX stacks of at most
+   SPAWN_STACK_CACHE_MAX_SIZE bytes are kept mapped and handed out again
+   to later calls that need no more than their size.  Once the child has
+   exec'ed or exited nothing refers to its stack any more, so it can be
+   reused right away.
+
+   A stack that has not been reused during the last SPAWN_STACK_CACHE_IDLE
+   spawns is marked MADV_FREE, which lets the kernel reclaim its pages
+   under memory pressure while the mapping itself stays in place.  Stacks
+   in steady use are never touched, so a tight spawn loop makes no
+   memory management system calls at all.  */
+#define SPAWN_STACK_CACHE_SLOTS		8
+#define SPAWN_STACK_CACHE_DEFAULT	4
+#define SPAWN_STACK_CACHE_MAX_SIZE	(1024 * 1024)
+#define SPAWN_STACK_CACHE_IDLE		64
+
+struct spawn_stack
+{
+  void *base;
+  size_t size;
+  unsigned long last_used;	/* value of STACK_CACHE.CLOCK when put back */
+  bool reclaimable;		/* pages have been marked MADV_FREE */
+};
+
+static struct
+{
+  pthread_mutex_t lock;
+  int max;
+  int used;
+  unsigned long clock;		/* number of stacks put back so far */
+  struct spawn_stack stacks[SPAWN_STACK_CACHE_SLOTS];
+} stack_cache = { PTHREAD_MUTEX_INITIALIZER, SPAWN_STACK_CACHE_DEFAULT };
+
+/* Return a stack of at least *SIZE bytes, taken from the cache if
+   possible.  *SIZE is updated to the size of the stack returned.  */
+static void *
+spawn_stack_get (size_t *size, int prot)
+{
+  pthread_mutex_lock (&stack_cache.lock);
+  int best = -1;
+  for (int i = 0; i < stack_cache.used; i++)
+    if (stack_cache.stacks[i].size >= *size
+	&& (best < 0
+	    || stack_cache.stacks[i].size < stack_cache.stacks[best].size))
+      best = i;
+
+  if (best >= 0)
+    {
+      void *stack = stack_cache.stacks[best].base;
+      *size = stack_cache.stacks[best].size;
+      stack_cache.stacks[best] = stack_cache.stacks[--stack_cache.used];
+      pthread_mutex_unlock (&stack_cache.lock);
+      return stack;
+    }
+  pthread_mutex_unlock (&stack_cache.lock);
+
+  return __mmap (NULL, *size, prot,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+}
+
+/* Give a stack back, keeping it for reuse if there is room.  */
+static void
+spawn_stack_put (void *stack, size_t size)
+{
+  if (size <= SPAWN_STACK_CACHE_MAX_SIZE)
+    {
+      pthread_mutex_lock (&stack_cache.lock);
+      unsigned long clock = ++stack_cache.clock;
+      for (int i = 0; i < stack_cache.used; i++)
+	{
+	  struct spawn_stack *s = &stack_cache.stacks[i];
+	  if (!s->reclaimable
+	      && clock - s->last_used > SPAWN_STACK_CACHE_IDLE)
+	    {
+	      __madvise (s->base, s->size, MADV_FREE);
+	      s->reclaimable = true;
+	    }
+	}
+      if (stack_cache.used < stack_cache.max)
+	{
+	  stack_cache.stacks[stack_cache.used++]
+	    = (struct spawn_stack) { stack, size, clock, false };
+	  pthread_mutex_unlock (&stack_cache.lock);
+	  return;
+	}
+      pthread_mutex_unlock (&stack_cache.lock);
+    }
+  __munmap (stack, size);
+}
+
+/* Keep at most NSTACKS child stacks mapped between calls (0 disables
+   the cache) and unmap those beyond that.  Returns the previous limit,
+   or -1 if NSTACKS is out of range.  */
+int
+posix_spawn_stack_cache_np (int nstacks)
+{
+  if (nstacks < 0 || nstacks > SPAWN_STACK_CACHE_SLOTS)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  pthread_mutex_lock (&stack_cache.lock);
+  int old = stack_cache.max;
+  stack_cache.max = nstacks;
+  while (stack_cache.used > nstacks)
+    {
+      struct spawn_stack *s = &stack_cache.stacks[--stack_cache.used];
+      __munmap (s->base, s->size);
+    }
+  pthread_mutex_unlock (&stack_cache.lock);
+  return old;
+}
+
 /* Spawn a new process executing PATH with the attributes describes in *ATTRP.
    Before running the process perform the actions described in FILE-ACTIONS. */
 static int
-__spawnix (pid_t * pid, const char *file,
+__spawnix (pid_t * pid, int *pidfd, const int *stdio, const char *file,
 	   const posix_spawn_file_actions_t * file_actions,
 	   const posix_spawnattr_t * attrp, char *const argv[],
 	   char *const envp[], int xflags,
 	   int (*exec) (const char *, char *const *, char *const *))
 {
   pid_t new_pid;
+  int new_pidfd = -1;
   struct posix_spawn_args args;
   int ec;
 
@@ -432,8 +640,7 @@ __spawnix (pid_t * pid, const char *file,
      extra pages won't actually be allocated unless they get used.  */
   argv_size += (32 * 1024);
   size_t stack_size = ALIGN_UP (argv_size, GLRO(dl_pagesize));
-  void *stack = __mmap (NULL, stack_size, prot,
-			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  void *stack = spawn_stack_get (&stack_size, prot);
   if (__glibc_unlikely (stack == MAP_FAILED))
     return errno;
 
@@ -452,6 +659,7 @@ __spawnix (pid_t * pid, const char *file,
   args.argc = argc;
   args.envp = envp;
   args.xflags = xflags;
+  args.stdio = stdio;
 
   __libc_signal_block_all (&args.oldmask);
 
@@ -462,9 +670,25 @@ __spawnix (pid_t * pid, const char *file,
      Also since the calling thread execution will be suspend, there is not
      need for CLONE_SETTLS.  Although parent and child share the same TLS
      namespace, there will be no concurrent access for TLS variables (errno
-     for instance).  */
+     for instance).
+
+     If the caller asked for a pidfd, CLONE_PIDFD has the kernel create it
+     atomically with the child, so it cannot refer to a recycled pid.  */
+  int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+  if (pidfd != NULL)
+    flags |= CLONE_PIDFD;
   new_pid = CLONE (__spawni_child, STACK (stack, stack_size), stack_size,
-		   CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+		   flags, &args, &new_pidfd);
+  /* Without a descriptor left for the pidfd, spawn the child without
+     one rather than not at all; *PIDFD is then -1.  */
+  if (new_pid == -1 && (flags & CLONE_PIDFD)
+      && (errno == EMFILE || errno == ENFILE))
+    {
+      flags &= ~CLONE_PIDFD;
+      new_pidfd = -1;
+      new_pid = CLONE (__spawni_child, STACK (stack, stack_size), stack_size,
+		       flags, &args, &new_pidfd);
+    }
 
   /* It needs to collect the case where the auxiliary process was created
      but failed to execute the file (due either any preparation step or
@@ -485,15 +709,22 @@ __spawnix (pid_t * pid, const char *file,
 	   to an unrelated process).  Unfortunately due synchronization
 	   issues where the kernel might not have the process collected
 	   the waitpid below can not use WNOHANG.  */
-	__waitpid (new_pid, NULL, 0);
+	{
+	  __waitpid (new_pid, NULL, 0);
+	  if (new_pidfd != -1)
+	    __close_nocancel (new_pidfd);
+	}
     }
   else
-    ec = -new_pid;
+    /* Kernels before 5.2 reject the unknown CLONE_PIDFD flag.  */
+    ec = ((flags & CLONE_PIDFD) && errno == EINVAL) ? ENOSYS : errno;
 
-  __munmap (stack, stack_size);
+  spawn_stack_put (stack, stack_size);
 
   if ((ec == 0) && (pid != NULL))
     *pid = new_pid;
+  if ((ec == 0) && (pidfd != NULL))
+    *pidfd = new_pidfd;
 
   __libc_signal_restore_set (&args.oldmask);
 
@@ -512,6 +743,20 @@ __spawni (pid_t * pid, const char *file,
 {
   /* It uses __execvpex to avoid run ENOEXEC in non compatibility mode (it
      will be handled by maybe_script_execute).  */
-  return __spawnix (pid, file, acts, attrp, argv, envp, xflags,
+  return __spawnix (pid, NULL, NULL, file, acts, attrp, argv, envp, xflags,
+		    xflags & SPAWN_XFLAGS_USE_PATH ? __execvpex :__execve);
+}
+
+/* Like __spawni, but also return a pidfd for the new process in PIDFD
+   unless it is NULL, and, unless STDIO is NULL, make STDIO[0] and
+   STDIO[1] the child's standard input and output (-1 leaves one as it
+   is).  */
+int
+__spawni_ext (pid_t * pid, int *pidfd, const int stdio[2], const char *file,
+	      const posix_spawn_file_actions_t * acts,
+	      const posix_spawnattr_t * attrp, char *const argv[],
+	      char *const envp[], int xflags)
+{
+  return __spawnix (pid, pidfd, stdio, file, acts, attrp, argv, envp, xflags,
 		    xflags & SPAWN_XFLAGS_USE_PATH ? __execvpex :__execve);
 }
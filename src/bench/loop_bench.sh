@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Measure how many loop iterations per second cush runs, next to dash
+# and bash.  Each script is one for loop over ITERATIONS words (default
+# 20000) whose body is either the builtin 'cd .', which shows the cost
+# of the loop itself, 'cd . || /bin/true', whose right side is skipped,
+# or the external command /bin/true.
+#
+# Usage: bench/loop_bench.sh [iterations [shell...]]
+# Run from src/ after building cush.
+
+iterations=${1:-20000}
+[ $# -gt 0 ] && shift
+shells=${*:-"./cush dash bash"}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+loop() {
+    printf 'for i in '
+    seq "$iterations" | tr '\n' ' '
+    printf '\ndo\n    %s\ndone\n' "$1"
+}
+loop 'cd .' > "$dir/builtin.sh"
+loop 'cd . || /bin/true' > "$dir/or.sh"
+loop '/bin/true' > "$dir/external.sh"
+
+now() {
+    date +%s.%N
+}
+
+printf '%-10s %-9s %10s %16s\n' shell body seconds iterations/sec
+for script in builtin or external; do
+    for shell in $shells; do
+        command -v "$shell" > /dev/null || continue
+        start=$(now)
+        "$shell" "$dir/$script.sh" < /dev/null > /dev/null
+        end=$(now)
+        echo "$shell $script $start $end $iterations" |
+            awk '{ t = $4 - $3; printf "%-10s %-9s %10.3f %16.0f\n", $1, $2, t, $5 / t }'
+    done
+done
@@ -0,0 +1,176 @@
+/*
+ * Benchmark the command line parser.
+ *
+ * Generates a corpus of long command lines -- pipelines of commands
+ * with plain and quoted words and redirections, separated by ';' and
+ * '&' -- and parses it repeatedly, reporting lines/sec and MB/sec.
+ * With -t, each thread parses the whole corpus with its own parser.
+ * With -c, lines go through a line_cache of the given capacity, so
+ * that after the first round a corpus that fits is shared, not parsed.
+ *
+ * Usage: parse_bench [-n lines] [-l bytes-per-line] [-r rounds] [-t threads]
+ *                    [-c capacity]
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shell-ast.h"
+#include "line_cache.h"
+
+static char **corpus;
+static size_t *lengths;
+static int nlines = 1000;
+static int rounds = 20;
+static int capacity = -1;       /* of the line cache, -1 for none */
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Append a random command line of about 'size' bytes to buf */
+static size_t
+generate_line(char *buf, size_t size)
+{
+    static const char *commands[] = { "ls", "grep", "sort", "uniq", "wc", "cut", "awk", "sed" };
+    size_t n = 0;
+    int words = 0;
+
+    n += sprintf(buf + n, "%s <input%d", commands[rand() % 8], rand() % 100);
+    while (n < size - 64) {
+        switch (rand() % 16) {
+        case 0:
+            n += sprintf(buf + n, " | %s", commands[rand() % 8]);
+            words = 0;
+            break;
+        case 1:
+            if (words > 0) {
+                n += sprintf(buf + n, " %s %s", rand() % 2 ? ";" : "&", commands[rand() % 8]);
+                words = 0;
+                break;
+            }
+            /* fall through */
+        case 2:
+            n += sprintf(buf + n, " \"quoted word %d\"", rand() % 1000);
+            words++;
+            break;
+        default:
+            n += sprintf(buf + n, " -%c%d", 'a' + rand() % 26, rand() % 10000);
+            words++;
+            break;
+        }
+    }
+    n += sprintf(buf + n, " >> output%d", rand() % 100);
+    return n;
+}
+
+static void *
+parse_cached(void *arg)
+{
+    struct line_cache cache;
+    line_cache_init(&cache, capacity);
+
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < nlines; i++) {
+            struct ast_command_line *cline = line_cache_parse(&cache, corpus[i], lengths[i]);
+            if (cline == NULL)
+                abort();
+            ast_command_line_free(cline);
+        }
+    line_cache_destroy(&cache);
+    return NULL;
+}
+
+static void *
+parse_corpus(void *arg)
+{
+    struct ast_parser *parser = ast_parser_create();
+    if (parser == NULL)
+        abort();
+
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < nlines; i++) {
+            struct ast_command_line *cline = ast_parser_parse(parser, corpus[i], lengths[i]);
+            if (cline == NULL)
+                abort();
+            ast_command_line_free(cline);
+        }
+    ast_parser_destroy(parser);
+    return NULL;
+}
+
+int
+main(int ac, char *av[])
+{
+    size_t line_size = 4096;
+    int nthreads = 1;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:l:r:t:c:")) > 0) {
+        switch (opt) {
+        case 'n':
+            nlines = atoi(optarg);
+            break;
+        case 'l':
+            line_size = atoi(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'c':
+            capacity = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n lines] [-l bytes-per-line] [-r rounds] [-t threads] [-c capacity]\n", av[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (line_size < 128)
+        line_size = 128;
+
+    srand(42);
+    corpus = calloc(nlines, sizeof *corpus);
+    lengths = calloc(nlines, sizeof *lengths);
+    size_t bytes = 0;
+    for (int i = 0; i < nlines; i++) {
+        corpus[i] = malloc(line_size + 64);
+        lengths[i] = generate_line(corpus[i], line_size);
+        bytes += lengths[i];
+    }
+
+    pthread_t *threads = calloc(nthreads, sizeof *threads);
+    double start = now();
+    for (int t = 0; t < nthreads; t++)
+        pthread_create(&threads[t], NULL, capacity >= 0 ? parse_cached : parse_corpus, NULL);
+    for (int t = 0; t < nthreads; t++)
+        pthread_join(threads[t], NULL);
+    double elapsed = now() - start;
+
+    double total_lines = (double) nlines * rounds * nthreads;
+    double total_bytes = (double) bytes * rounds * nthreads;
+    printf("%d lines of %zu bytes on average, %d rounds, %d threads",
+           nlines, bytes / nlines, rounds, nthreads);
+    if (capacity >= 0)
+        printf(", line cache of %d", capacity);
+    printf("\n");
+    printf("%.3f s  %.0f lines/sec  %.1f MB/sec\n",
+           elapsed, total_lines / elapsed, total_bytes / elapsed * 1e-6);
+
+    for (int i = 0; i < nlines; i++)
+        free(corpus[i]);
+    free(corpus);
+    free(lengths);
+    free(threads);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/*
+ * Benchmark finding the job that a reaped child belongs to.
+ *
+ * Builds a job table of NJOBS jobs with NPIDS processes each and
+ * then "reaps" every process in random order, once with the nested
+ * job_list/pid_list scan cush used to do and once with pid_index.
+ * No processes are actually forked; only the lookup is measured.
+ *
+ * Usage: pid_index_bench [njobs [pids-per-job]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "list.h"
+#include "pid_index.h"
+
+struct job {
+    struct list_elem elem;
+    struct list pid_list;
+    int num_processes_alive;
+};
+
+struct pid_mult {
+    pid_t pid2;
+    struct list_elem mult_elem;
+};
+
+static struct list job_list;
+
+static struct job *
+scan_job_list(pid_t pid)
+{
+    for (struct list_elem *e = list_begin(&job_list); e != list_end(&job_list); e = list_next(e)) {
+        struct job *job = list_entry(e, struct job, elem);
+        for (struct list_elem *p = list_begin(&job->pid_list); p != list_end(&job->pid_list); p = list_next(p))
+            if (list_entry(p, struct pid_mult, mult_elem)->pid2 == pid)
+                return job;
+    }
+    return NULL;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main(int ac, char *av[])
+{
+    int njobs = ac > 1 ? atoi(av[1]) : 5000;
+    int npids = ac > 2 ? atoi(av[2]) : 10;
+    int total = njobs * npids;
+
+    struct job *jobs = calloc(njobs, sizeof *jobs);
+    struct pid_mult *procs = calloc(total, sizeof *procs);
+    pid_t *order = calloc(total, sizeof *order);
+    struct pid_index index;
+
+    list_init(&job_list);
+    pid_index_init(&index);
+    srand(3214);
+
+    /* Spawn: pids are handed out roughly sequentially, like the kernel does */
+    pid_t next_pid = 1000;
+    for (int j = 0; j < njobs; j++) {
+        list_init(&jobs[j].pid_list);
+        list_push_back(&job_list, &jobs[j].elem);
+        for (int k = 0; k < npids; k++) {
+            struct pid_mult *p = &procs[j * npids + k];
+            p->pid2 = next_pid += 1 + rand() % 3;
+            list_push_back(&jobs[j].pid_list, &p->mult_elem);
+            pid_index_insert(&index, p->pid2, &jobs[j]);
+            order[j * npids + k] = p->pid2;
+            jobs[j].num_processes_alive++;
+        }
+    }
+
+    /* Children exit in arbitrary order */
+    for (int i = total - 1; i > 0; i--) {
+        int r = rand() % (i + 1);
+        pid_t t = order[i];
+        order[i] = order[r];
+        order[r] = t;
+    }
+
+    double start = now();
+    for (int i = 0; i < total; i++)
+        scan_job_list(order[i])->num_processes_alive--;
+    double scan = now() - start;
+
+    start = now();
+    for (int i = 0; i < total; i++)
+        ((struct job *) pid_index_remove(&index, order[i]))->num_processes_alive++;
+    double hashed = now() - start;
+
+    for (int j = 0; j < njobs; j++)
+        if (jobs[j].num_processes_alive != npids) {
+            fprintf(stderr, "job %d: lookups disagree\n", j);
+            return EXIT_FAILURE;
+        }
+
+    printf("reaped %d children across %d jobs\n", total, njobs);
+    printf("%-12s %10.3f ms %10.1f ns/reap\n", "list scan", scan * 1e3, scan * 1e9 / total);
+    printf("%-12s %10.3f ms %10.1f ns/reap\n", "pid index", hashed * 1e3, hashed * 1e9 / total);
+
+    pid_index_destroy(&index);
+    free(order);
+    free(procs);
+    free(jobs);
+    return EXIT_SUCCESS;
+}
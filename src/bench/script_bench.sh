@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Measure how many commands per second cush runs from a script, next
+# to dash and bash.  Two scripts of LINES lines (default 100000) are
+# generated: one runs the external command /bin/true on every line,
+# the other the builtin 'cd .', which shows the cost of reading and
+# parsing alone.
+#
+# Usage: bench/script_bench.sh [lines [shell...]]
+# Run from src/ after building cush.
+
+lines=${1:-100000}
+[ $# -gt 0 ] && shift
+shells=${*:-"./cush dash bash"}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+yes /bin/true | head -n "$lines" > "$dir/external.sh"
+yes 'cd .' | head -n "$lines" > "$dir/builtin.sh"
+
+now() {
+    date +%s.%N
+}
+
+printf '%-10s %-9s %10s %14s\n' shell script seconds commands/sec
+for script in builtin external; do
+    for shell in $shells; do
+        command -v "$shell" > /dev/null || continue
+        start=$(now)
+        "$shell" "$dir/$script.sh" < /dev/null > /dev/null
+        end=$(now)
+        echo "$shell $script $start $end $lines" |
+            awk '{ t = $4 - $3; printf "%-10s %-9s %10.3f %14.0f\n", $1, $2, t, $5 / t }'
+    done
+done
@@ -0,0 +1,216 @@
+/*
+ * bytecode - compile the statements of a command line and run them.
+ *
+ * The compiled forms, whose jumps test the status of the last pipeline run:
+ *
+ *   a && b     a; JUMP_IF_FAILED end; b; end:
+ *   a || b     a; JUMP_IF_OK end; b; end:
+ *   if c; then t; else e; fi
+ *              c; JUMP_IF_FAILED else; t; JUMP end; else: e; end:
+ *              (without an else part, e is STATUS 0)
+ *   while c; do b; done
+ *              WHILE_START l; top: c; JUMP_IF_FAILED out; b; SAVE_STATUS l;
+ *              JUMP top; out: RESTORE_STATUS l
+ *              (until uses JUMP_IF_OK; the loop's status is that of its
+ *              last body run, or 0, not that of the test that ended it)
+ *   for v in w...; do b; done
+ *              FOR_START l; top: FOR_NEXT l; b; JUMP top; end:
+ *              (FOR_NEXT jumps to loops[l].exit, end, after the last word)
+ */
+#include <stdlib.h>
+
+#include "bytecode.h"
+#include "utils.h"
+
+#define BC_MIN_SIZE 16
+
+/* Make room for one more element of 'elsize' bytes in *array */
+static void *
+grow(void *array, size_t n, size_t *size, size_t elsize)
+{
+    if (n < *size)
+        return array;
+
+    *size = *size == 0 ? BC_MIN_SIZE : 2 * *size;
+    array = realloc(array, *size * elsize);
+    if (array == NULL)
+        utils_fatal_error("cannot allocate program: ");
+    return array;
+}
+
+/* Append an instruction; returns its address */
+static size_t
+emit(struct bc_program *prog, enum bc_op op, size_t operand)
+{
+    prog->code = grow(prog->code, prog->ncode, &prog->code_size, sizeof *prog->code);
+    prog->code[prog->ncode] = op | (uint32_t) (operand & BC_OPERAND_MAX) << BC_OP_BITS;
+    return prog->ncode++;
+}
+
+/* Make the jump at 'at' go to the next instruction emitted */
+static void
+patch(struct bc_program *prog, size_t at)
+{
+    prog->code[at] = (prog->code[at] & BC_OP_MASK)
+                     | (uint32_t) (prog->ncode & BC_OPERAND_MAX) << BC_OP_BITS;
+}
+
+static void compile_stmts(struct bc_program *prog, struct list *stmts);
+
+static void
+compile_node(struct bc_program *prog, struct ast_node *node)
+{
+    size_t top, jump, end, loop;
+
+    switch (node->kind) {
+    case AST_PIPELINE:
+        prog->pipes = grow(prog->pipes, prog->npipes, &prog->pipes_size, sizeof *prog->pipes);
+        prog->pipes[prog->npipes] = node->pipe;
+        emit(prog, ast_pipeline_has_vars(node->pipe) ? BC_RUN_EXPAND : BC_RUN, prog->npipes++);
+        break;
+
+    case AST_AND:
+    case AST_OR:
+        compile_node(prog, node->left);
+        jump = emit(prog, node->kind == AST_AND ? BC_JUMP_IF_FAILED : BC_JUMP_IF_OK, 0);
+        compile_node(prog, node->right);
+        patch(prog, jump);
+        break;
+
+    case AST_IF:
+        compile_stmts(prog, node->cond);
+        jump = emit(prog, BC_JUMP_IF_FAILED, 0);
+        compile_stmts(prog, node->body);
+        end = emit(prog, BC_JUMP, 0);
+        patch(prog, jump);
+        if (node->else_part != NULL)
+            compile_stmts(prog, node->else_part);
+        else
+            emit(prog, BC_STATUS, 0);
+        patch(prog, end);
+        break;
+
+    case AST_WHILE:
+    case AST_UNTIL:
+        prog->loops = grow(prog->loops, prog->nloops, &prog->loops_size, sizeof *prog->loops);
+        loop = prog->nloops++;
+        emit(prog, BC_WHILE_START, loop);
+        top = prog->ncode;
+        compile_stmts(prog, node->cond);
+        jump = emit(prog, node->kind == AST_WHILE ? BC_JUMP_IF_FAILED : BC_JUMP_IF_OK, 0);
+        compile_stmts(prog, node->body);
+        emit(prog, BC_SAVE_STATUS, loop);
+        emit(prog, BC_JUMP, top);
+        patch(prog, jump);
+        emit(prog, BC_RESTORE_STATUS, loop);
+        break;
+
+    case AST_FOR:
+        prog->loops = grow(prog->loops, prog->nloops, &prog->loops_size, sizeof *prog->loops);
+        loop = prog->nloops++;
+        prog->loops[loop].var = node->var;
+        prog->loops[loop].words = node->words;
+        emit(prog, BC_FOR_START, loop);
+        top = emit(prog, BC_FOR_NEXT, loop);
+        compile_stmts(prog, node->body);
+        emit(prog, BC_JUMP, top);
+        prog->loops[loop].exit = prog->ncode;
+        break;
+    }
+}
+
+static void
+compile_stmts(struct bc_program *prog, struct list *stmts)
+{
+    for (struct list_elem *e = list_begin(stmts); e != list_end(stmts); e = list_next(e))
+        compile_node(prog, list_entry(e, struct ast_node, elem));
+}
+
+/* Compile a list of statements */
+bool
+bc_compile(struct bc_program *prog, struct list *stmts)
+{
+    prog->code = NULL;
+    prog->ncode = prog->code_size = 0;
+    prog->pipes = NULL;
+    prog->npipes = prog->pipes_size = 0;
+    prog->loops = NULL;
+    prog->nloops = prog->loops_size = 0;
+
+    compile_stmts(prog, stmts);
+
+    // Operands were truncated if any address or index does not fit
+    if (prog->ncode > BC_OPERAND_MAX || prog->npipes > BC_OPERAND_MAX || prog->nloops > BC_OPERAND_MAX) {
+        bc_free(prog);
+        return false;
+    }
+    return true;
+}
+
+void
+bc_free(struct bc_program *prog)
+{
+    free(prog->code);
+    free(prog->pipes);
+    free(prog->loops);
+    prog->code = NULL;
+    prog->pipes = NULL;
+    prog->loops = NULL;
+}
+
+/* Run the program */
+bool
+bc_run(struct bc_program *prog, const struct bc_ops *ops, void *ctx, int *status)
+{
+    const uint32_t *code = prog->code;
+    size_t pc = 0;
+
+    while (pc < prog->ncode) {
+        enum bc_op op = code[pc] & BC_OP_MASK;
+        uint32_t operand = code[pc++] >> BC_OP_BITS;
+        struct bc_loop *loop;
+
+        switch (op) {
+        case BC_RUN:
+        case BC_RUN_EXPAND:
+            if (!ops->run(prog->pipes[operand], op == BC_RUN_EXPAND, ctx, status))
+                return false;
+            break;
+        case BC_JUMP:
+            pc = operand;
+            break;
+        case BC_JUMP_IF_OK:
+            if (*status == 0)
+                pc = operand;
+            break;
+        case BC_JUMP_IF_FAILED:
+            if (*status != 0)
+                pc = operand;
+            break;
+        case BC_STATUS:
+            *status = operand;
+            break;
+        case BC_FOR_START:
+            prog->loops[operand].next = 0;
+            *status = 0;        // if there are no words
+            break;
+        case BC_FOR_NEXT:
+            loop = &prog->loops[operand];
+            if (loop->words[loop->next] == NULL)
+                pc = loop->exit;
+            else
+                ops->set_var(loop->var, loop->words[loop->next++], ctx);
+            break;
+        case BC_WHILE_START:
+            prog->loops[operand].status = 0;    // if the body never runs
+            break;
+        case BC_SAVE_STATUS:
+            prog->loops[operand].status = *status;
+            break;
+        case BC_RESTORE_STATUS:
+            *status = prog->loops[operand].status;
+            break;
+        }
+    }
+    return true;
+}
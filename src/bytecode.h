@@ -0,0 +1,78 @@
+#ifndef __BYTECODE_H
+#define __BYTECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shell-ast.h"
+
+/* The statements of a command line, compiled to a compact bytecode.
+ *
+ * Each instruction is one 32-bit word: the opcode in the low 8 bits
+ * and an operand, such as a jump target or an index into pipes[] or
+ * loops[], in the upper 24.  Control flow ('&&', '||', if, while,
+ * until, for) becomes jumps on the exit status of the last pipeline,
+ * so running a loop or a short-circuit test costs nothing beyond the
+ * pipelines it runs.
+ */
+enum bc_op {
+    BC_RUN,             /* run pipes[operand] */
+    BC_RUN_EXPAND,      /* the same, expanding its variables first */
+    BC_JUMP,            /* continue at operand */
+    BC_JUMP_IF_OK,      /* ... if the status is 0 */
+    BC_JUMP_IF_FAILED,  /* ... if it is not */
+    BC_STATUS,          /* set the status to operand */
+    BC_FOR_START,       /* start loops[operand] at its first word */
+    BC_FOR_NEXT,        /* set its variable to the next word, or leave
+                           the loop if there is none */
+    BC_WHILE_START,     /* set the status of loops[operand] to 0 */
+    BC_SAVE_STATUS,     /* save the status in loops[operand] */
+    BC_RESTORE_STATUS,  /* set the status to the one saved there */
+};
+
+#define BC_OP_BITS 8
+#define BC_OP_MASK ((1u << BC_OP_BITS) - 1)
+#define BC_OPERAND_MAX ((1u << (32 - BC_OP_BITS)) - 1)
+
+/* A for loop, or a while or until loop, which only uses 'status' */
+struct bc_loop {
+    const char *var;
+    char **words;               /* NULL terminated */
+    uint32_t exit;              /* where to continue once done */
+    size_t next;                /* the next word, while running */
+    int status;                 /* of the last body run, while running */
+};
+
+struct bc_program {
+    uint32_t *code;
+    size_t ncode, code_size;
+    struct ast_pipeline **pipes;
+    size_t npipes, pipes_size;
+    struct bc_loop *loops;
+    size_t nloops, loops_size;
+};
+
+/* What the shell does for the program */
+struct bc_ops {
+    /* Run a pipeline and store its exit status in *status; return
+     * false to stop the program, e.g. after ^C */
+    bool (*run)(struct ast_pipeline *pipe, bool expand, void *ctx, int *status);
+    /* Set the variable of a for loop */
+    void (*set_var)(const char *name, const char *value, void *ctx);
+};
+
+/* Compile a list of statements.  The program refers to the pipelines
+ * and words of their command line, which must outlive it.  Returns
+ * false if the program would be too large to encode. */
+bool bc_compile(struct bc_program *prog, struct list *stmts);
+
+/* Free the program's arrays */
+void bc_free(struct bc_program *prog);
+
+/* Run the program, starting with and updating the exit status in
+ * *status.  Returns false if ops->run stopped it.  A program runs
+ * one at a time. */
+bool bc_run(struct bc_program *prog, const struct bc_ops *ops, void *ctx, int *status);
+
+#endif /* __BYTECODE_H */
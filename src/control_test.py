@@ -0,0 +1,74 @@
+#
+# Tests control flow: '&&', '||', if, while and for
+#
+# Checks that statements run depending on the status of the ones
+# before them, that a statement may go on over several lines, that
+# keywords are only recognized where a command may start, and that
+# variables are expanded in unquoted words only.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+#
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. '&&' and '||'
+#
+sendline("true && echo one | tr o O")
+expect_exact("One", "Expected && to run its right side")
+expect_prompt("Shell did not print expected prompt after &&")
+sendline("false && echo bad || echo status-$? | tr a-z A-Z")
+expect_exact("STATUS-1", "Expected || to run with the status of false")
+expect_prompt("Shell did not print expected prompt after ||")
+
+# Step 2. for, with the loop variable expanded
+#
+sendline("for w in x y z; do echo item-$w | tr a-z A-Z; done")
+expect_exact("ITEM-X", "Expected the first iteration")
+expect_exact("ITEM-Y", "Expected the second iteration")
+expect_exact("ITEM-Z", "Expected the third iteration")
+expect_prompt("Shell did not print expected prompt after for")
+
+# Step 3. while
+#
+flag = os.path.join(tempfile.mkdtemp(), "flag")
+atexit.register(os.rmdir, os.path.dirname(flag))
+sendline(f"touch {flag}; while test -e {flag}; do rm {flag}; echo looped | tr a-z A-Z; done")
+expect_exact("LOOPED", "Expected the body of the loop to run")
+expect_prompt("Shell did not print expected prompt after while")
+
+# The status of a loop is that of its body, not of the test ending it
+sendline(f"touch {flag}; while test -e {flag}; do rm {flag}; false; done; echo status-$? | tr a-z A-Z")
+expect_exact("STATUS-1", "Expected the status of the last body run")
+expect_prompt("Shell did not print expected prompt after while")
+
+# Step 4. An if that goes on over several lines
+#
+sendline("if false")
+expect_exact("> ", "Expected a continuation prompt")
+sendline("then echo no")
+sendline("else echo yes | tr a-z A-Z")
+sendline("fi")
+expect_exact("YES", "Expected the else part to run")
+expect_prompt("Shell did not print expected prompt after if")
+
+# Step 5. Keywords are words elsewhere, quoted words are not expanded
+#
+sendline("echo done fi | tr a-z A-Z")
+expect_exact("DONE FI", "Expected keywords to be printed as arguments")
+expect_prompt()
+sendline('echo "$home" | tr a-z A-Z')
+expect_exact("$HOME", "Expected a quoted word to be taken literally")
+expect_prompt()
+
+#################################################################
+
+test_success()
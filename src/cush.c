@@ -12,8 +12,14 @@
 #include <string.h>
 #include <termios.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/syscall.h>
 
 /* Since the handed out code contains a number of unused functions. */
 #pragma GCC diagnostic ignored "-Wunused-function"
@@ -22,18 +28,41 @@
 #include "signal_support.h"
 #include "shell-ast.h"
 #include "utils.h"
+#include "pid_index.h"
+#include "id_alloc.h"
+#include "slab.h"
+#include "status_ring.h"
+#include "path_cache.h"
+#include "spawn_plan.h"
+#include "stage_attr.h"
+#include "line_reader.h"
+#include "line_cache.h"
+#include "bytecode.h"
 #include <spawn.h>
 #include <readline/history.h>
 #include <limits.h>
 
-static void handle_child_status(pid_t pid, int status);
-static struct job *get_job_from_pid(pid_t pid);
+static void handle_child_status(pid_t pid, int status, const struct rusage *usage);
+static void reap_children(void);
+static void delete_completed_jobs(bool notify);
+
+/* Self-pipe the SIGCHLD handler writes to after it reaped children */
+static int sigchld_wakeup[2] = { -1, -1 };
+static struct pid_mult *get_process_from_pid(pid_t pid);
 
 static void
 usage(char *progname)
 {
-    printf("Usage: %s -h\n"
-           " -h            print this help\n",
+    printf("Usage: %s [-he] [-p size] [-c commands | script]\n"
+           " -h            print this help\n"
+           " -e            event loop mode: learn about child status\n"
+           "               changes through a signalfd instead of a\n"
+           "               SIGCHLD handler\n"
+           " -p size       capacity of the pipes in pipelines, in bytes\n"
+           "               (K and M suffixes allowed), or 'auto' to\n"
+           "               grow pipes whose writer is blocked\n"
+           " -c commands   run the given commands, one per line, and exit\n"
+           " script        run the commands in the file 'script' and exit\n",
            progname);
 
     exit(EXIT_SUCCESS);
@@ -61,6 +90,7 @@ struct job
 {
     struct list_elem elem;          /* Link element for jobs list. */
     struct ast_pipeline *pipe;      /* The pipeline of commands this job represents */
+    struct ast_command_line *cline; /* The command line whose arena holds 'pipe' */
     int jid;                        /* Job id. */
     enum job_status status;         /* Job status. */
     int num_processes_alive;        /* The number of processes that we know to be alive */
@@ -71,6 +101,11 @@ struct job
     pid_t pid;            /* Process id of the job */
     struct list pid_list; /* List of PIDs associated with the job */
     pid_t pgid;           /* Process group id of the job */
+    struct rusage usage;  /* Resources used by the processes reaped so far */
+    struct timespec started; /* When the job was created */
+    bool timed;           /* User asked for the 'time' of this job */
+    int pipe_size;        /* Capacity of its pipes, see 'pipesize' */
+    int exit_status;      /* Exit status of its last stage, shell-style */
 };
 
 // Struct for jobs that contain multiple processes
@@ -78,50 +113,188 @@ struct pid_mult
 {
     pid_t pid2;
     struct list_elem mult_elem;
+    struct job *job;          /* Job this process belongs to */
+    struct ast_command *cmd;  /* Pipeline stage this process runs */
+    bool reaped;              /* True once the process exited or was killed */
+    bool left_group;          /* True if it left the job's process group,
+                                 e.g. with setsid */
+    int pidfd;                /* pidfd referring to it until reaped, or -1;
+                                 only for foreground 'pipesize auto' jobs */
+    int pipe_size;            /* Capacity of its stdin pipe, once sampled */
+    struct rusage usage;      /* Resources it used, valid once reaped */
 };
 
+/* Capacity of the pipes between the stages of a pipeline.  0 leaves
+ * the kernel's default; PIPE_SIZE_AUTO starts with it and doubles the
+ * capacity of a pipe whenever its writer is found blocked, up to the
+ * system-wide limit.  Set with -p or 'pipesize'. */
+#define PIPE_SIZE_AUTO (-1)
+static int default_pipe_size;
+static int pipe_max_size = 1048576;     /* /proc/sys/fs/pipe-max-size */
+static unsigned long pipes_grown;
+
+/* Cleared if the kernel cannot create pidfds with CLONE_PIDFD */
+static bool use_pidfds = true;
+
+/* False when running a script or -c commands, or reading commands from
+ * something other than a terminal.  Such input is read without readline
+ * and no history is kept, and background jobs are not reported. */
+static bool interactive = true;
+
+/* Exit status of the last foreground job; a script exits with it */
+static int last_status;
+
+/* How often the pipes of a job are looked at in PIPE_SIZE_AUTO mode */
+static const struct timespec pipe_sample_interval = { 0, 10 * 1000 * 1000 };
+
+/* Learn how large unprivileged users may make a pipe */
+static void
+read_pipe_max_size(void)
+{
+    FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (f == NULL)
+        return;
+    int size;
+    if (fscanf(f, "%d", &size) == 1 && size > 0)
+        pipe_max_size = size;
+    fclose(f);
+}
+
+/* Parse a pipe capacity: 'auto', 'default', or a number of bytes with an
+ * optional K or M suffix.  Larger sizes than allowed are reduced. */
+static bool
+parse_pipe_size(const char *s, int *size)
+{
+    if (strcmp(s, "auto") == 0)
+    {
+        *size = PIPE_SIZE_AUTO;
+        return true;
+    }
+    if (strcmp(s, "default") == 0)
+    {
+        *size = 0;
+        return true;
+    }
+    if (*s < '0' || *s > '9')
+        return false;
+
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(s, &end, 10);
+    unsigned long unit = 1;
+    if (*end == 'K' || *end == 'k')
+        unit = 1024, end++;
+    else if (*end == 'M' || *end == 'm')
+        unit = 1024 * 1024, end++;
+    if (errno != 0 || *end != '\0')
+        return false;
+    *size = n > (unsigned long) pipe_max_size / unit ? pipe_max_size : (int) (n * unit);
+    return true;
+}
+
+/* Remove the first n words of a command, such as a 'time' prefix.
+ * The words stay in the command line's arena until it is released. */
+static void
+drop_words(char **argv, size_t n)
+{
+    char **p = argv;
+    do
+    {
+        p[0] = p[n];
+    } while (*p++ != NULL);
+}
+
+/* Show or set the pipe capacity for later pipelines ('pipesize') */
+static void
+pipe_size_builtin(char **argv)
+{
+    if (argv[1] != NULL)
+    {
+        if (argv[2] != NULL || !parse_pipe_size(argv[1], &default_pipe_size))
+            fprintf(stderr, "pipesize: usage: pipesize [bytes[K|M] | auto | default] [command...]\n");
+        return;
+    }
+    if (default_pipe_size == PIPE_SIZE_AUTO)
+        printf("auto (up to %d bytes)\n", pipe_max_size);
+    else if (default_pipe_size == 0)
+        printf("default\n");
+    else
+        printf("%d\n", default_pipe_size);
+}
+
 /* Utility functions for job list management.
- * We use 2 data structures:
- * (a) an array jid2job to quickly find a job based on its id
+ * We use 3 data structures:
+ * (a) an array jid2job to quickly find a job based on its id.
+ *     It starts small, doubles whenever a job id does not fit, and
+ *     is halved again once the ids in use fit into a quarter of it.
  * (b) a linked list to support iteration
+ * (c) a hash index pid2proc to find the pid_mult record (and thus
+ *     the job) of a child process.  A pid is added when the process
+ *     is spawned and removed when it is reaped, so the index only
+ *     ever holds live processes.
+ * Job ids are handed out by free_jids, which always returns the
+ * lowest id not in use.
+ * struct job and struct pid_mult objects come from slab caches,
+ * so their memory is reused from one job to the next.
  */
-#define MAXJOBS (1 << 16)
+#define MINJOBS 16
 static struct list job_list;
 
-static struct job *jid2job[MAXJOBS];
+static struct job **jid2job;
+static size_t jid2job_size;
+static struct pid_index pid2proc;
+static struct id_alloc free_jids;
+static struct slab_cache job_cache;
+static struct slab_cache pid_mult_cache;
 
 /* Return job corresponding to jid */
 static struct job *
 get_job_from_jid(int jid)
 {
-    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
+    if (jid > 0 && (size_t) jid < jid2job_size && jid2job[jid] != NULL)
         return jid2job[jid];
 
     return NULL;
 }
 
+/* Resize the jid2job array, clearing any newly added entries */
+static void
+resize_jid2job(size_t size)
+{
+    struct job **table = realloc(jid2job, size * sizeof *table);
+    if (table == NULL)
+        utils_fatal_error("cannot resize job table: ");
+
+    for (size_t i = jid2job_size; i < size; i++)
+        table[i] = NULL;
+    jid2job = table;
+    jid2job_size = size;
+}
+
 /* Add a new job to the job list */
 static struct job *
-add_job(struct ast_pipeline *pipe)
+add_job(struct ast_command_line *cline, struct ast_pipeline *pipe)
 {
-    struct job *job = malloc(sizeof *job);
+    struct job *job = slab_alloc(&job_cache);
     job->pipe = pipe;
+    job->cline = ast_command_line_ref(cline);
     job->num_processes_alive = 0;
+    job->timed = false;
+    job->status = FOREGROUND;
+    job->pipe_size = default_pipe_size;
+    job->exit_status = 0;
+    memset(&job->usage, 0, sizeof job->usage);
+    clock_gettime(CLOCK_MONOTONIC, &job->started);
     list_push_back(&job_list, &job->elem);
     // Initalize job list
     list_init(&job->pid_list);
-    for (int i = 1; i < MAXJOBS; i++)
-    {
-        if (jid2job[i] == NULL)
-        {
-            jid2job[i] = job;
-            job->jid = i;
-            return job;
-        }
-    }
-    fprintf(stderr, "Maximum number of jobs exceeded\n");
-    abort();
-    return NULL;
+    int jid = id_alloc_get(&free_jids);
+    if ((size_t) jid >= jid2job_size)
+        resize_jid2job(2 * jid2job_size);
+    assert(jid2job[jid] == NULL);
+    jid2job[jid] = job;
+    job->jid = jid;
+    return job;
 }
 
 /* Delete a job.
@@ -135,8 +308,24 @@ delete_job(struct job *job)
     assert(jid != -1);
     jid2job[jid]->jid = -1;
     jid2job[jid] = NULL;
-    ast_pipeline_free(job->pipe);
-    free(job);
+    id_alloc_put(&free_jids, jid);
+    // All ids in use are below free_jids.next; give back unused space
+    size_t size = jid2job_size;
+    while (size > MINJOBS && (size_t) free_jids.next <= size / 4)
+        size /= 2;
+    if (size != jid2job_size)
+        resize_jid2job(size);
+    // Free the processes associated with the job
+    for (struct list_elem *e = list_begin(&job->pid_list); e != list_end(&job->pid_list); )
+    {
+        struct pid_mult *job_pid = list_entry(e, struct pid_mult, mult_elem);
+        e = list_remove(e);
+        if (job_pid->pidfd != -1)
+            close(job_pid->pidfd);
+        slab_free(&pid_mult_cache, job_pid);
+    }
+    ast_command_line_free(job->cline);
+    slab_free(&job_cache, job);
 }
 
 static const char *
@@ -185,6 +374,80 @@ print_job(struct job *job)
     printf(")\n");
 }
 
+/* Add the resources in 'usage' to 'total'.
+ * ru_maxrss is a peak, so the total keeps the largest one seen. */
+static void
+add_rusage(struct rusage *total, const struct rusage *usage)
+{
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+    if (usage->ru_maxrss > total->ru_maxrss)
+        total->ru_maxrss = usage->ru_maxrss;
+    total->ru_minflt += usage->ru_minflt;
+    total->ru_majflt += usage->ru_majflt;
+    total->ru_inblock += usage->ru_inblock;
+    total->ru_oublock += usage->ru_oublock;
+    total->ru_nvcsw += usage->ru_nvcsw;
+    total->ru_nivcsw += usage->ru_nivcsw;
+}
+
+/* Print CPU time, peak memory and context switches on one line */
+static void
+print_rusage(FILE *out, const struct rusage *usage)
+{
+    fprintf(out, "user %ld.%03lds  sys %ld.%03lds  maxrss %ldK  ctxsw %ld/%ld",
+            (long) usage->ru_utime.tv_sec, (long) usage->ru_utime.tv_usec / 1000,
+            (long) usage->ru_stime.tv_sec, (long) usage->ru_stime.tv_usec / 1000,
+            usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw);
+}
+
+/* Print a job followed by each of its processes and the resources
+ * they used ('jobs -l').  Processes that have not exited yet have
+ * nothing to report. */
+static void
+print_job_long(struct job *job)
+{
+    print_job(job);
+    for (struct list_elem *e = list_begin(&job->pid_list); e != list_end(&job->pid_list); e = list_next(e))
+    {
+        struct pid_mult *proc = list_entry(e, struct pid_mult, mult_elem);
+        printf("\t%d\t%-8s", proc->pid2, proc->reaped ? "done" : "running");
+        if (proc->reaped)
+            print_rusage(stdout, &proc->usage);
+        printf("\t(%s)\n", proc->cmd->argv[0]);
+    }
+    printf("\ttotal\t");
+    print_rusage(stdout, &job->usage);
+    printf("\n");
+}
+
+/* Report the time and resources a finished job used ('time' prefix).
+ * For pipelines, also break them down by stage. */
+static void
+print_job_times(struct job *job)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long real_ms = (now.tv_sec - job->started.tv_sec) * 1000
+                 + (now.tv_nsec - job->started.tv_nsec) / 1000000;
+
+    fprintf(stderr, "\nreal\t%ld.%03lds\n", real_ms / 1000, real_ms % 1000);
+    fprintf(stderr, "user\t%ld.%03lds\n", (long) job->usage.ru_utime.tv_sec,
+            (long) job->usage.ru_utime.tv_usec / 1000);
+    fprintf(stderr, "sys\t%ld.%03lds\n", (long) job->usage.ru_stime.tv_sec,
+            (long) job->usage.ru_stime.tv_usec / 1000);
+
+    if (list_size(&job->pid_list) < 2)
+        return;
+    for (struct list_elem *e = list_begin(&job->pid_list); e != list_end(&job->pid_list); e = list_next(e))
+    {
+        struct pid_mult *proc = list_entry(e, struct pid_mult, mult_elem);
+        fprintf(stderr, "  %-12s ", proc->cmd->argv[0]);
+        print_rusage(stderr, &proc->usage);
+        fprintf(stderr, "\n");
+    }
+}
+
 /*
  * Suggested SIGCHLD handler.
  *
@@ -202,16 +465,231 @@ print_job(struct job *job)
  */
 static void
 sigchld_handler(int sig, siginfo_t *info, void *_ctxt)
+{
+    int saved_errno = errno;
+    assert(sig == SIGCHLD);
+
+    reap_children();
+    // Wake up the prompt loop so it can process what was reaped
+    if (write(sigchld_wakeup[1], "", 1) == -1 && errno != EAGAIN)
+        abort();
+    errno = saved_errno;
+}
+
+/* Consume the bytes the SIGCHLD handler wrote to sigchld_wakeup */
+static void
+drain_sigchld_wakeup(void)
+{
+    char buf[64];
+
+    for (;;)
+    {
+        ssize_t n = read(sigchld_wakeup[0], buf, sizeof buf);
+        if (n > 0 || (n == -1 && errno == EINTR))
+            continue;
+        if (n == -1 && errno != EAGAIN)
+            utils_error("reading the SIGCHLD wakeup pipe failed: ");
+        return;
+    }
+}
+
+/*
+ * Child status changes are not applied to the job list where they are
+ * reaped.  reap_children() only records them in the child_events ring,
+ * which is safe to do from the SIGCHLD handler, and
+ * handle_child_events() later applies them in batches from the main
+ * program.  If the ring fills up, reaping stops and the remaining
+ * children are left as zombies until handle_child_events() has made
+ * room again.
+ */
+static struct status_ring child_events;
+
+/* Reap every child whose status changed, without blocking, for as
+ * long as there is room to record it.  Async-signal-safe. */
+static void
+reap_children(void)
 {
     pid_t child;
     int status;
+    struct rusage usage;
 
-    assert(sig == SIGCHLD);
+    while (status_ring_has_room(&child_events))
+    {
+        if ((child = wait4(-1, &status, WUNTRACED | WNOHANG, &usage)) <= 0)
+            return;
+        status_ring_push(&child_events, child, status, &usage);
+    }
+    status_ring_note_overflow(&child_events);
+}
+
+/*
+ * Event loop mode (-e).
+ *
+ * SIGCHLD stays blocked for the whole life of the shell and no handler
+ * is installed.  Instead, a signalfd becomes readable when a child
+ * changes state, and the shell reaps at points where it is safe to
+ * touch the job list.  This makes the signal_block/signal_unblock pair
+ * around each pipeline unnecessary.  wait_for_job() is unaffected
+ * since it already runs with SIGCHLD blocked.
+ *
+ * In either mode, child_event_fd becomes readable when there are
+ * child events to process: it is the signalfd in event loop mode and
+ * the read end of sigchld_wakeup otherwise.
+ */
+static bool event_loop;
+static int child_event_fd = -1;
+
+/* Apply all recorded child status changes to the job list.
+ * In event loop mode, first reap whatever the signalfd announced. */
+static void
+handle_child_events(void)
+{
+    struct child_status batch[64];
+    size_t n;
+
+    // Consume the notification before looking at the ring, so that
+    // events recorded from now on will cause a new one
+    if (event_loop)
+    {
+        signal_drain_fd(child_event_fd);
+        reap_children();
+    }
+    else
+    {
+        drain_sigchld_wakeup();
+    }
+
+    for (;;)
+    {
+        while ((n = status_ring_pop(&child_events, batch, sizeof batch / sizeof batch[0])) > 0)
+        {
+            for (size_t i = 0; i < n; i++)
+                handle_child_status(batch[i].pid, batch[i].status, &batch[i].usage);
+            // Emit whatever the batch printed in one go
+            fflush(stdout);
+        }
+
+        // Pick up the children left behind when the ring was full.
+        // SIGCHLD is blocked so the handler cannot push concurrently.
+        if (!status_ring_take_overflow(&child_events))
+            break;
+        bool was_blocked = signal_block(SIGCHLD);
+        reap_children();
+        if (!was_blocked)
+            signal_unblock(SIGCHLD);
+    }
+}
+
+/*
+ * Reading a command line.
+ *
+ * readline's callback interface is used so that the shell never blocks
+ * inside readline.  Instead, one poll() loop waits for both keystrokes
+ * and child events.  Jobs that finish while the user is typing are
+ * reaped, reported and deleted right away; the prompt and the partial
+ * input are then redrawn below the notification.
+ */
+static char *line_read;         /* Line passed to line_handler */
+static bool line_complete;      /* line_handler has been called */
 
-    while ((child = waitpid(-1, &status, WUNTRACED | WNOHANG)) > 0)
+/* Called by readline once a line (or EOF, NULL) has been entered */
+static void
+line_handler(char *line)
+{
+    line_read = line;
+    line_complete = true;
+    rl_callback_handler_remove();
+}
+
+/* Process child events while readline owns the input line */
+static void
+handle_events_at_prompt(void)
+{
+    rl_clear_visible_line();
+    handle_child_events();
+    delete_completed_jobs(true);
+    fflush(stdout);
+    rl_forced_update_display();
+}
+
+/* Read a command line, handling child events while waiting.
+ * Returns a malloc'ed line or NULL on EOF. */
+static char *
+read_command_line(const char *prompt)
+{
+    struct pollfd fds[2] = {
+        { .fd = fileno(rl_instream ? rl_instream : stdin), .events = POLLIN },
+        { .fd = child_event_fd, .events = POLLIN },
+    };
+
+    line_complete = false;
+    rl_callback_handler_install(prompt, line_handler);
+    while (!line_complete)
     {
-        handle_child_status(child, status);
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            utils_fatal_error("poll failed: ");
+        }
+        if (fds[1].revents & POLLIN)
+            handle_events_at_prompt();
+        if (fds[0].revents)
+            rl_callback_read_char();
     }
+    return line_read;
+}
+
+/* Double the capacity of each pipe in the job that is full, i.e. whose
+ * writer is blocked ('pipesize auto').  The pipes are reached through
+ * the standard input of the stages after the first. */
+static void
+grow_full_pipes(struct job *job)
+{
+    struct list_elem *e;
+    for (e = list_next(list_begin(&job->pid_list)); e != list_end(&job->pid_list); e = list_next(e))
+    {
+        struct pid_mult *proc = list_entry(e, struct pid_mult, mult_elem);
+        if (proc->reaped || proc->pidfd < 0)
+            continue;
+
+        int size;
+        int rc = posix_spawn_pipe_grow_np(proc->pidfd, STDIN_FILENO, pipe_max_size, &size);
+        if (rc == EPERM || rc == ENOSYS)
+        {
+            // We may not look at the children's descriptors
+            job->pipe_size = 0;
+            return;
+        }
+        if (rc != 0)
+            continue;
+        if (proc->pipe_size != 0 && size > proc->pipe_size)
+            pipes_grown++;
+        proc->pipe_size = size;
+    }
+}
+
+/* Pick the process of a job to wait for next, one not yet reaped.  A
+ * process still in the job's process group comes first, since ^Z stops
+ * it along with the job; those found to have left the group, e.g. with
+ * setsid, are noted, since signals sent to the group do not reach them.
+ * Returns NULL if all were reaped. */
+static struct pid_mult *
+next_process_to_wait_for(struct job *job)
+{
+    struct pid_mult *outside = NULL;
+    for (struct list_elem *e = list_begin(&job->pid_list); e != list_end(&job->pid_list); e = list_next(e))
+    {
+        struct pid_mult *proc = list_entry(e, struct pid_mult, mult_elem);
+        if (proc->reaped)
+            continue;
+        if (!proc->left_group && getpgid(proc->pid2) == job->pgid)
+            return proc;
+        proc->left_group = true;
+        if (outside == NULL)
+            outside = proc;
+    }
+    return outside;
 }
 
 /* Wait for all processes in this job to complete, or for
@@ -236,17 +714,52 @@ sigchld_handler(int sig, siginfo_t *info, void *_ctxt)
  * The code below relies on `job->status` having been set to FOREGROUND
  * and `job->num_processes_alive` having been set to the number of
  * processes successfully forked for this job.
+ *
+ * Only the job's own processes are waited for, one at a time, and the
+ * kernel wakes the shell only for the one it waits for.  Status changes
+ * of other (background) children stay pending while the foreground job
+ * runs and are handled together afterwards: by the SIGCHLD handler once
+ * SIGCHLD is unblocked, or at the next prompt in event loop mode.
  */
 static void
 wait_for_job(struct job *job)
 {
     assert(signal_is_blocked(SIGCHLD));
 
+    // Exits the handler already recorded must be counted first
+    handle_child_events();
+
+    sigset_t sigchld;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    bool sigchld_taken = false;
+
     while (job->status == FOREGROUND && job->num_processes_alive > 0)
     {
         int status;
+        struct rusage usage;
+        int options = WUNTRACED;
+        struct pid_mult *proc = next_process_to_wait_for(job);
+        // Should the count be off, any child will do
+        pid_t wait_for = proc != NULL ? proc->pid2 : -1;
 
-        pid_t child = waitpid(-1, &status, WUNTRACED);
+        // 'pipesize auto': look at the pipes whenever nothing happened
+        // for a while
+        bool sample = job->pipe_size == PIPE_SIZE_AUTO && proc != NULL && proc->pidfd != -1;
+        if (sample)
+        {
+            options |= WNOHANG;
+        }
+
+        pid_t child = wait4(wait_for, &status, options, &usage);
+        if (child == 0)
+        {
+            if (sigtimedwait(&sigchld, NULL, &pipe_sample_interval) == SIGCHLD)
+                sigchld_taken = true;
+            else
+                grow_full_pipes(job);
+            continue;
+        }
 
         // When called here, any error returned by waitpid indicates a logic
         // bug in the shell.
@@ -258,17 +771,25 @@ wait_for_job(struct job *job)
         // Since SIGCHLD is blocked, there cannot be races where a child's exit
         // was handled via the SIGCHLD signal handler.
         if (child != -1)
-            handle_child_status(child, status);
+            handle_child_status(child, status, &usage);
         else
             utils_fatal_error("waitpid failed, see code for explanation");
     }
+
+    // The signal may have been for another child, which the handler
+    // or the event loop must still learn about
+    if (sigchld_taken)
+        raise(SIGCHLD);
+
+    if (job->timed && job->num_processes_alive == 0)
+        print_job_times(job);
 }
 
+/* Apply one child status change to the job list.
+ * Called from the main program only, never from a signal handler. */
 static void
-handle_child_status(pid_t pid, int status)
+handle_child_status(pid_t pid, int status, const struct rusage *usage)
 {
-    assert(signal_is_blocked(SIGCHLD));
-
     /* To be implemented.
      * Step 1. Given the pid, determine which job this pid is a part of
      *         (how to do this is not part of the provided code.)
@@ -281,7 +802,28 @@ handle_child_status(pid_t pid, int status)
 
         // Updated to save terminal states when needed
 
-    struct job *job = get_job_from_pid(pid);
+    struct pid_mult *proc = get_process_from_pid(pid);
+    // Not one of ours, e.g. already reaped by the spawn library
+    if (proc == NULL)
+        return;
+    struct job *job = proc->job;
+    // A process that exited or was killed can no longer change state;
+    // charge its final resource usage to its stage and its job
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+        pid_index_remove(&pid2proc, pid);
+        proc->reaped = true;
+        if (proc->pidfd != -1)
+        {
+            close(proc->pidfd);
+            proc->pidfd = -1;
+        }
+        proc->usage = *usage;
+        add_rusage(&job->usage, usage);
+        if (&proc->mult_elem == list_back(&job->pid_list))
+            job->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+
     // Process exists via exit()
     if (WIFEXITED(status))
     {
@@ -346,33 +888,16 @@ handle_child_status(pid_t pid, int status)
     }
 }
 
-// Utility function to find job based on pid, updated to handle jobs with multiple processes
-static struct job *get_job_from_pid(pid_t pid)
+// Utility function to find a process (and its job) based on pid
+static struct pid_mult *get_process_from_pid(pid_t pid)
 {
-    // Iterarte through job list
-    struct list_elem *job_elem;
-    for (job_elem = list_begin(&job_list); job_elem != list_end(&job_list); job_elem = list_next(job_elem))
-    {
-        struct job *current_job = list_entry(job_elem, struct job, elem);
-        struct list_elem *pid_elem;
-        // Iterate through processes associated with the current job
-        for (pid_elem = list_begin(&current_job->pid_list); pid_elem != list_end(&current_job->pid_list); pid_elem = list_next(pid_elem))
-        {
-            struct pid_mult *current_pid_elem = list_entry(pid_elem, struct pid_mult, mult_elem);
-            pid_t current_pid = current_pid_elem->pid2;
-            // Check if the current process's pid matches the given pid
-            if (current_pid == pid)
-            {
-                return current_job;
-            }
-        }
-    }
-    // Return NULL if no jobs matches pid
-    return NULL;
+    // Return NULL if no live process of any job has this pid
+    return pid_index_lookup(&pid2proc, pid);
 }
 
 // Utility function to delete completed jobs from the job list
-static void delete_completed_jobs()
+// If notify is true, report background jobs that ran to completion
+static void delete_completed_jobs(bool notify)
 {
     struct list_elem *current_job_elem;
     struct list_elem *next_job_elem;
@@ -384,12 +909,199 @@ static void delete_completed_jobs()
         // Delete job when needed
         if (job->num_processes_alive == 0)
         {
+            if (notify && job->status == BACKGROUND)
+            {
+                printf("[%d]\tDone\t\t(", job->jid);
+                print_cmdline(job->pipe);
+                printf(")\n");
+            }
             list_remove(current_job_elem);
             delete_job(job);
         }
     }
 }
 
+/* Send sig to a job's process group, and so also to the processes its
+ * stages started, as long as a process of the job has not been reaped.
+ * An unreaped process, even a zombie, keeps the group id from being
+ * reused.  Stages that left the group are signalled on their own,
+ * through their pidfd if they have one. */
+static void
+send_signal_to_job(struct job *job, int sig)
+{
+    bool unreaped = false;
+    for (struct list_elem *e = list_begin(&job->pid_list); e != list_end(&job->pid_list); e = list_next(e))
+    {
+        struct pid_mult *proc = list_entry(e, struct pid_mult, mult_elem);
+        if (proc->reaped)
+            continue;
+        unreaped = true;
+        if (!proc->left_group && getpgid(proc->pid2) == job->pgid)
+            continue;
+        if (proc->pidfd != -1)
+            syscall(SYS_pidfd_send_signal, proc->pidfd, sig, NULL, 0);
+        else
+            kill(proc->pid2, sig);
+    }
+    if (unreaped)
+        killpg(job->pgid, sig);
+}
+
+/* Where commands were last found on PATH, see 'hash' */
+static struct path_cache command_hash;
+
+/* How recently run pipelines were spawned */
+#define SPAWN_PLANS 64
+static struct spawn_plan_cache spawn_plans;
+
+/* Recently parsed command lines */
+#define PARSED_LINES 64
+static struct line_cache parsed_lines;
+
+/* Commands the shell runs itself */
+static const char *builtins[] = {
+    "jobs", "stats", "exit", "fg", "bg", "kill", "stop", "cd", "history",
+    "hash", "type", "pipesize", NULL
+};
+
+/* Return true if the keywords at the start of 'argv', such as 'nice',
+ * are followed by a command for them to apply to */
+static bool
+keywords_precede_command(char **argv)
+{
+    struct stage_attr *attr;
+    size_t nwords;
+    if (!stage_attr_parse(argv, &attr, &nwords, true))
+        return false;
+    stage_attr_free(attr);
+    return argv[nwords] != NULL;
+}
+
+/* Describe how the shell would run 'name', in the manner of bash's 'type' */
+static void
+print_command_type(const char *name)
+{
+    if (strcmp(name, "time") == 0 || stage_attr_keyword(name))
+    {
+        printf("%s is a shell keyword\n", name);
+        return;
+    }
+    for (const char **b = builtins; *b != NULL; b++)
+    {
+        if (strcmp(name, *b) == 0)
+        {
+            printf("%s is a shell builtin\n", name);
+            return;
+        }
+    }
+
+    const char *path = path_cache_peek(&command_hash, name);
+    if (path != NULL)
+    {
+        printf("%s is hashed (%s)\n", name, path);
+        return;
+    }
+    char *found = NULL;
+    if (strchr(name, '/') == NULL)
+        found = path_search(name);
+    else if (access(name, X_OK) == 0)
+        found = strdup(name);
+    if (found != NULL)
+        printf("%s is %s\n", name, found);
+    else
+        fprintf(stderr, "cush: type: %s: not found\n", name);
+    free(found);
+}
+
+
+/* Spawn the given commands of job's pipeline, connected by pipes, as
+ * the processes of job.  All stages are created in one call to the
+ * spawn library, which puts them into one process group from within
+ * the children.  What to spawn comes from a cached plan if the same
+ * pipeline ran before. */
+static void
+spawn_job(struct job *job, struct ast_command **cmds, size_t n, const sigset_t *child_sigmask)
+{
+    struct ast_pipeline *pipeline = job->pipe;
+    struct spawn_plan *plan = spawn_plan_get(&spawn_plans, &command_hash, pipeline, cmds, n, child_sigmask);
+    job->status = pipeline->bg_job ? BACKGROUND : FOREGROUND;
+    if (plan == NULL)
+    {
+        job->exit_status = 127;
+        return;
+    }
+
+    pid_t *pids = malloc(n * sizeof *pids);
+    int *pidfds = malloc(n * sizeof *pidfds);
+    if (pids == NULL || pidfds == NULL)
+        utils_fatal_error("cannot allocate pipeline: ");
+
+    // Pipes are made anew each time, so their size is not part of the plan
+    for (size_t i = 0; i < n; i++)
+        plan->stages[i].pipe_size = job->pipe_size > 0 ? job->pipe_size : 0;
+
+    // Anything builtins printed must come out before what the children print
+    fflush(stdout);
+    // pidfds are only needed to look at the pipes of a foreground job
+    // ('pipesize auto'); every one held takes up a descriptor
+    bool want_pidfds = use_pidfds && job->status == FOREGROUND && job->pipe_size == PIPE_SIZE_AUTO;
+    int rc = posix_spawn_pipeline_np(pids, want_pidfds ? pidfds : NULL, n, plan->stages, &plan->attr, environ);
+    if (rc == ENOSYS && want_pidfds)
+    {
+        // No CLONE_PIDFD; nothing was spawned, so try again without
+        use_pidfds = false;
+        rc = posix_spawn_pipeline_np(pids, NULL, n, plan->stages, &plan->attr, environ);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (pids[i] < 0)
+        {
+            fprintf(stderr, "spawn failed: %s\n", strerror(-pids[i]));
+            if (i == n - 1)
+                job->exit_status = 127;
+            // If the remembered path went stale, search PATH next time
+            if (plan->paths[i] != NULL)
+                path_cache_forget(&command_hash, plan->stages[i].argv[0]);
+            continue;
+        }
+
+        // Initalize pid of job
+        struct pid_mult *job_pid = slab_alloc(&pid_mult_cache);
+        job_pid->pid2 = pids[i];
+        job_pid->job = job;
+        job_pid->cmd = cmds[i];
+        job_pid->reaped = false;
+        job_pid->left_group = false;
+        job_pid->pidfd = want_pidfds && use_pidfds ? pidfds[i] : -1;
+        job_pid->pipe_size = 0;
+        // Add to end of pid list
+        list_push_back(&job->pid_list, &job_pid->mult_elem);
+        pid_index_insert(&pid2proc, pids[i], job_pid);
+        // The first process leads the job's process group
+        if (job->num_processes_alive == 0)
+        {
+            job->pgid = pids[i];
+        }
+        // Update process count
+        job->num_processes_alive++;
+        // Print out info if background job
+        if (job->status == BACKGROUND)
+        {
+            if (interactive)
+                printf("[%d] %d\n", job->jid, pids[i]);
+            termstate_save(&job->saved_tty_state);
+        }
+    }
+
+    free(pids);
+    free(pidfds);
+}
+
+/* Children start with no signals blocked, whatever the shell's
+ * own mask is when it spawns them. */
+static sigset_t child_sigmask;
+
 // Utility function to update the directory using 'cd' built-in especially for 'cd -'
 char *prev_dir = NULL;
 char *current_dir = NULL;
@@ -401,29 +1113,400 @@ static void update_directory(const char *new_dir)
     chdir(new_dir);
     // Store current directory in temp_dir
     getcwd(temp_dir, PATH_MAX);
-    // Update pointers
+    // Update pointers; a loop may run cd many times
+    free(prev_dir);
     prev_dir = current_dir;
     current_dir = temp_dir;
 }
 
+/* Look up a variable for ast_pipeline_expand: $? is the exit status
+ * of the last pipeline, anything else comes from the environment */
+static const char *
+lookup_var(const char *name)
+{
+    static char status[16];
+    if (strcmp(name, "?") == 0)
+    {
+        snprintf(status, sizeof status, "%d", last_status);
+        return status;
+    }
+    return getenv(name);
+}
+
+/* Set the variable of a for loop.  The shell has no variables of its
+ * own, so it is exported to the commands in the loop. */
+static void
+set_var(const char *name, const char *value, void *ctx)
+{
+    if (setenv(name, value, 1) == -1)
+        fprintf(stderr, "cush: %s: %s\n", name, strerror(errno));
+}
+
+/* Run one pipeline of the command line 'ctx' for the bytecode VM.
+ * Returns false if it was stopped or interrupted with ^C. */
+static bool
+run_pipeline(struct ast_pipeline *pipeline, bool expand, void *ctx, int *status)
+{
+    struct ast_command_line *cline = ctx;
+    if (!event_loop)
+        signal_block(SIGCHLD);
+
+    // Parsed lines are shared and may run again, e.g. in a loop, so
+    // pipelines whose words change are run from a copy
+    struct ast_command_line *owner = cline;
+    struct ast_command *first = list_entry(list_begin(&pipeline->commands), struct ast_command, elem);
+    if (expand || strcmp(first->argv[0], "time") == 0 || strcmp(first->argv[0], "pipesize") == 0)
+    {
+        owner = ast_command_line_create();
+        owner->words_from = ast_command_line_ref(cline);
+        pipeline = expand ? ast_pipeline_expand(owner, pipeline, lookup_var) : ast_pipeline_copy(owner, pipeline);
+        first = list_entry(list_begin(&pipeline->commands), struct ast_command, elem);
+    }
+    // Current job user types in
+    struct job *job = add_job(owner, pipeline);
+    if (owner != cline)
+        ast_command_line_free(owner);   // the job holds it
+
+    // 'time' prefix: run the rest of the pipeline, then report what it used;
+    // 'pipesize size' prefix: run it with pipes of that size
+    for (;;)
+    {
+        if (strcmp(first->argv[0], "time") == 0 && first->argv[1] != NULL)
+        {
+            drop_words(first->argv, 1);
+            job->timed = true;
+        }
+        else if (strcmp(first->argv[0], "pipesize") == 0 && first->argv[1] != NULL
+                 && first->argv[2] != NULL && parse_pipe_size(first->argv[1], &job->pipe_size))
+        {
+            drop_words(first->argv, 2);
+        }
+        else
+            break;
+    }
+
+    // Commands that are not builtins, in pipeline order
+    size_t nstages = 0;
+    struct ast_command **stages = malloc(list_size(&pipeline->commands) * sizeof *stages);
+    if (stages == NULL)
+        utils_fatal_error("cannot allocate pipeline: ");
+
+    // Iterate over each command in the pipeline
+    struct list_elem *cmd_elem;
+    for (cmd_elem = list_begin(&pipeline->commands); cmd_elem != list_end(&pipeline->commands); cmd_elem = list_next(cmd_elem))
+    {
+        struct ast_command *cmd = list_entry(cmd_elem, struct ast_command, elem);
+
+        // Implementing built-in commands
+        if (strcmp(cmd->argv[0], "jobs") == 0 && cmd->argv[1] != NULL && strcmp(cmd->argv[1], "--mem") == 0)
+        {
+            // Report the job allocators so leaks can be spotted
+            slab_cache_print(&job_cache);
+            slab_cache_print(&pid_mult_cache);
+        }
+        else if (strcmp(cmd->argv[0], "jobs") == 0 && cmd->argv[1] != NULL && strcmp(cmd->argv[1], "-l") == 0)
+        {
+            // Like 'jobs', but list every process and what it used
+            for (struct list_elem *e = list_begin(&job_list); e != list_end(&job_list); e = list_next(e))
+            {
+                struct job *jobs = list_entry(e, struct job, elem);
+                if (jobs->status != FOREGROUND)
+                {
+                    print_job_long(jobs);
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "jobs") == 0)
+        {
+            // Iterate through entire job list and print if not in foreground
+            for (struct list_elem *e = list_begin(&job_list); e != list_end(&job_list); e = list_next(e))
+            {
+                struct job *jobs = list_entry(e, struct job, elem);
+                if (jobs->status != FOREGROUND)
+                {
+                    print_job(jobs);
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "pipesize") == 0)
+        {
+            pipe_size_builtin(cmd->argv);
+        }
+        else if (strcmp(cmd->argv[0], "stats") == 0)
+        {
+            // Report how child status changes were processed
+            status_ring_print(&child_events);
+            path_cache_print_stats(&command_hash);
+            spawn_plan_cache_print(&spawn_plans);
+            line_cache_print(&parsed_lines);
+            printf("pipes:\t\t%lu grown\n", pipes_grown);
+        }
+        else if (strcmp(cmd->argv[0], "hash") == 0)
+        {
+            if (cmd->argv[1] == NULL)
+            {
+                path_cache_print(&command_hash);
+            }
+            else if (strcmp(cmd->argv[1], "-r") == 0)
+            {
+                // Forget every remembered location
+                path_cache_clear(&command_hash);
+            }
+            else
+            {
+                // Look up and remember each named command
+                for (char **name = cmd->argv + 1; *name != NULL; name++)
+                {
+                    if (path_cache_lookup(&command_hash, *name) == NULL && strchr(*name, '/') == NULL)
+                    {
+                        fprintf(stderr, "cush: hash: %s: not found\n", *name);
+                    }
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "type") == 0)
+        {
+            for (char **name = cmd->argv + 1; *name != NULL; name++)
+            {
+                print_command_type(*name);
+            }
+        }
+        else if (strcmp(cmd->argv[0], "exit") == 0)
+        {
+            // Working as intended
+            exit(cmd->argv[1] != NULL ? atoi(cmd->argv[1]) : 0);
+        }
+        else if (strcmp(cmd->argv[0], "fg") == 0)
+        {
+            // Use either atoi or strol per discord
+            // Converting string to int
+            int jid = atoi(cmd->argv[1]);
+            if (get_job_from_jid(jid) != NULL)
+            {
+                struct job *job = get_job_from_jid(jid);
+                if (job)
+                {
+                    // Give the terminal to the job
+                    termstate_give_terminal_to(&job->saved_tty_state, job->pgid);
+                    // Continue job if it was stopped (accounts for user ^Z)
+                    if (job->status != FOREGROUND)
+                    {
+                        send_signal_to_job(job, SIGCONT);
+                    }
+                    // Set status to foreground
+                    job->status = FOREGROUND;
+                    // Print out info to terminal (for tests)
+                    print_cmdline(job->pipe);
+                    printf(")\n");
+                    wait_for_job(job);
+                    // Give the terminal back to the shell
+                    termstate_give_terminal_back_to_shell();
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "bg") == 0)
+        {
+            // Converting string to int
+            int jid = atoi(cmd->argv[1]);
+            if (get_job_from_jid(jid) != NULL)
+            {
+                struct job *job = get_job_from_jid(jid);
+                // Continue job if it was stopped (accounts for user ^Z)
+                if (job && job->status != BACKGROUND)
+                {
+                    send_signal_to_job(job, SIGCONT);
+                    // Set status to background
+                    job->status = BACKGROUND;
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "kill") == 0)
+        {
+            // Converting string to int
+            int jid = atoi(cmd->argv[1]);
+            if (get_job_from_jid(jid) != NULL)
+            {
+                struct job *job = get_job_from_jid(jid);
+                if (job)
+                {
+                    // Terminate job
+                    send_signal_to_job(job, SIGTERM);
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "stop") == 0)
+        {
+            // Converting string to int
+            int jid = atoi(cmd->argv[1]);
+            if (get_job_from_jid(jid) != NULL)
+            {
+                struct job *job = get_job_from_jid(jid);
+                if (job)
+                {
+                    // Stop job
+                    send_signal_to_job(job, SIGSTOP);
+                }
+            }
+        }
+        else if (strcmp(cmd->argv[0], "cd") == 0)
+        {
+            if (cmd->argv[1] != NULL)
+            {
+                if (strcmp(cmd->argv[1], "-") == 0)
+                {
+                    // Calling utility function for 'cd -' case
+                    if (prev_dir)
+                    {
+                        update_directory(prev_dir);
+                        printf("%s\n", current_dir);
+                    }
+                }
+                update_directory(cmd->argv[1]);
+            }
+            else
+            {
+                // Go to home directory if user does not specify
+                update_directory(getenv("HOME"));
+            }
+        }
+        else if (strcmp(cmd->argv[0], "history") == 0)
+        {
+            // Referenced https://linux.die.net/man/3/history
+            // History list
+            HIST_ENTRY **the_history_list = history_list();
+            int i = 0;
+            // Loop through list and print (entry number, command)
+            while (the_history_list[i] != NULL)
+            {
+                // history_base is entry position stored in zero based index
+                int entry = history_base + i;
+                // 'line' contains the command string
+                char *command = the_history_list[i]->line;
+                printf("    %d %s\n", entry, command);
+                i++;
+            }
+        }
+        else if (stage_attr_keyword(cmd->argv[0]) && !keywords_precede_command(cmd->argv))
+        {
+            // 'ulimit', 'nice' etc. without a command act on the shell
+            if (stage_attr_builtin(cmd->argv))
+            {
+                // Cached plans hold limits derived from the old ones
+                spawn_plan_cache_clear(&spawn_plans);
+            }
+        }
+        else
+        {
+            // Handling non built in functions
+            stages[nstages++] = cmd;
+        }
+    }
+    if (nstages > 0)
+    {
+        spawn_job(job, stages, nstages, &child_sigmask);
+    }
+    free(stages);
+    wait_for_job(job);
+    // Like sh, a background job or a builtin counts as success
+    *status = nstages > 0 && job->status != BACKGROUND ? job->exit_status : 0;
+    // ^C or ^Z also stops the rest of the command line, e.g. a loop
+    bool go_on = true;
+    if (job->status == STOPPED)
+    {
+        *status = 128 + SIGTSTP;
+        go_on = false;
+    }
+    else if (job->status == DEAD && job->exit_status == 128 + SIGINT)
+        go_on = false;
+    // A loop may run many jobs; those done with need not wait for the prompt
+    if (job->num_processes_alive == 0 && job->status != BACKGROUND)
+    {
+        list_remove(&job->elem);
+        delete_job(job);
+    }
+    if (!event_loop)
+        signal_unblock(SIGCHLD);
+    termstate_give_terminal_back_to_shell();
+    return go_on;
+}
+
+static const struct bc_ops vm_ops = { run_pipeline, set_var };
+
 int main(int ac, char *av[])
 {
     int opt;
 
     /* Process command-line arguments. See getopt(3) */
-    while ((opt = getopt(ac, av, "h")) > 0)
+    read_pipe_max_size();
+
+    char *commands = NULL;
+    while ((opt = getopt(ac, av, "hep:c:")) > 0)
     {
         switch (opt)
         {
         case 'h':
             usage(av[0]);
             break;
+        case 'e':
+            event_loop = true;
+            break;
+        case 'p':
+            if (!parse_pipe_size(optarg, &default_pipe_size))
+                usage(av[0]);
+            break;
+        case 'c':
+            commands = optarg;
+            break;
         }
     }
 
+    // Commands not typed at a terminal are read in large chunks instead
+    struct line_reader script;
+    if (commands != NULL)
+        line_reader_init_string(&script, commands);
+    else if (optind < ac)
+    {
+        int fd = open(av[optind], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            utils_fatal_error("cannot open %s: ", av[optind]);
+        line_reader_init_fd(&script, fd);
+    }
+    else if (!isatty(STDIN_FILENO))
+        line_reader_init_fd(&script, STDIN_FILENO);
+    interactive = commands == NULL && optind == ac && isatty(STDIN_FILENO);
+
     list_init(&job_list);
-    signal_set_handler(SIGCHLD, sigchld_handler);
-    termstate_init();
+    pid_index_init(&pid2proc);
+    id_alloc_init(&free_jids, 1);
+    status_ring_init(&child_events);
+    path_cache_init(&command_hash);
+    spawn_plan_cache_init(&spawn_plans, SPAWN_PLANS);
+    line_cache_init(&parsed_lines, PARSED_LINES);
+    resize_jid2job(MINJOBS);
+    slab_cache_init(&job_cache, "job", sizeof(struct job), 64);
+    slab_cache_init(&pid_mult_cache, "pid_mult", sizeof(struct pid_mult), 256);
+    if (event_loop)
+        child_event_fd = signal_open_fd(SIGCHLD);
+    else
+    {
+        if (pipe2(sigchld_wakeup, O_CLOEXEC | O_NONBLOCK) == -1)
+            utils_fatal_error("cannot create SIGCHLD wakeup pipe: ");
+        child_event_fd = sigchld_wakeup[0];
+        signal_set_handler(SIGCHLD, sigchld_handler);
+    }
+    if (interactive)
+        termstate_init();
+    else if (termstate_try_init())
+        spawn_plans.tty_fd = termstate_get_tty_fd();
+    else
+        spawn_plans.tty_fd = -1;   // e.g. under cron, nobody to hand it to
+
+    sigemptyset(&child_sigmask);
+
+    /* The lines read so far of a statement that goes on over several,
+     * such as a loop, joined by newlines; NULL if there is none */
+    char *continued = NULL;
+    size_t continued_len = 0;
 
     /* Read/eval loop. */
     for (;;)
@@ -434,8 +1517,15 @@ int main(int ac, char *av[])
          * unable to receive SIGCHLD signals, and thus would be unable to
          * wait for background jobs that may finish while the
          * shell is sitting at the prompt waiting for user input.
+         * In event loop mode, SIGCHLD is always blocked and child
+         * events are handled while waiting for input instead.
          */
-        assert(!signal_is_blocked(SIGCHLD));
+        if (!event_loop)
+            assert(!signal_is_blocked(SIGCHLD));
+
+        // Bring the job list up to date with what happened meanwhile
+        handle_child_events();
+        delete_completed_jobs(interactive);
 
         /* If you fail this assertion, you were about to call readline()
          * without having terminal ownership.
@@ -443,329 +1533,102 @@ int main(int ac, char *av[])
          * Make sure that you call termstate_give_terminal_back_to_shell()
          * before returning here on all paths.
          */
-        assert(termstate_get_current_terminal_owner() == getpgrp());
+        if (termstate_has_terminal())
+            assert(termstate_get_current_terminal_owner() == getpgrp());
 
-        /* Do not output a prompt unless shell's stdin is a terminal */
-        char *prompt = isatty(0) ? build_prompt() : NULL;
-        char *cmdline = readline(prompt);
-
-        // delete job do anywhere between here and where we spawn the processes (after ast_commandlineprint(cline))
-        delete_completed_jobs();
+        char *cmdline;
+        if (interactive)
+        {
+            char *prompt = continued == NULL ? build_prompt() : NULL;
+            cmdline = read_command_line(prompt != NULL ? prompt : "> ");
+            free(prompt);
 
-        free(prompt);
+            // delete job do anywhere between here and where we spawn the processes (after ast_commandlineprint(cline))
+            handle_child_events();
+            delete_completed_jobs(true);
+        }
+        else
+        {
+            size_t len;
+            cmdline = line_reader_next(&script, &len);
+        }
 
         if (cmdline == NULL) /* User typed EOF */
+        {
+            if (continued != NULL)
+            {
+                fprintf(stderr, "cush: unexpected end of file\n");
+                free(continued);
+                last_status = 2;
+            }
             break;
+        }
+
+        if (!interactive && cmdline[strspn(cmdline, " \t")] == '#')
+            continue;   // a comment, or the #! line of a script
 
         // Tracking history
-        add_history(cmdline);
+        if (interactive)
+            add_history(cmdline);
 
-        struct ast_command_line *cline = ast_parse_command_line(cmdline);
-        free(cmdline);
+        size_t len = strlen(cmdline);
+        char *text = cmdline;
+        if (continued != NULL)
+        {
+            continued = realloc(continued, continued_len + len + 2);
+            if (continued == NULL)
+                utils_fatal_error("cannot allocate command line: ");
+            continued[continued_len] = '\n';
+            memcpy(continued + continued_len + 1, cmdline, len + 1);
+            continued_len += len + 1;
+            text = continued;
+            len = continued_len;
+        }
+
+        // Lines run before need not be parsed again
+        struct ast_command_line *cline = line_cache_parse(&parsed_lines, text, len);
+        if (cline == NULL && ast_parser_incomplete(parsed_lines.parser))
+        {
+            // e.g. inside a loop, or after '&&': read on
+            if (continued == NULL && (continued = strdup(cmdline)) == NULL)
+                utils_fatal_error("cannot allocate command line: ");
+            continued_len = len;
+            if (interactive)
+                free(cmdline);
+            continue;
+        }
+        if (interactive)
+            free(cmdline);
+        free(continued);
+        continued = NULL;
         if (cline == NULL) /* Error in command line */
             continue;
 
-        if (list_empty(&cline->pipes))
+        if (list_empty(cline->stmts))
         { /* User hit enter */
             ast_command_line_free(cline);
             continue;
         }
 
-        // Iterate over each pipeline
-        struct list_elem *pipe_elem;
-        for (pipe_elem = list_begin(&cline->pipes); pipe_elem != list_end(&cline->pipes); pipe_elem = list_next(pipe_elem))
-        {
-            signal_block(SIGCHLD);
-            struct ast_pipeline *pipeline = list_entry(pipe_elem, struct ast_pipeline, elem);
-            // Current job user types in
-            struct job *job = add_job(pipeline);
-            
-            int fds[2];
-            int fds2[2];
-            int close0 = -1;
-            int close1 = -1;
-            bool piped = false;
-
-            // Iterate over each command in the pipeline
-            struct list_elem *cmd_elem;
-            for (cmd_elem = list_begin(&pipeline->commands); cmd_elem != list_end(&pipeline->commands); cmd_elem = list_next(cmd_elem))
-            {
-                struct ast_command *cmd = list_entry(cmd_elem, struct ast_command, elem);
-
-                // Implementing built-in commands
-                if (strcmp(cmd->argv[0], "jobs") == 0)
-                {
-                    // Iterate through entire job list and print if not in foreground
-                    for (struct list_elem *e = list_begin(&job_list); e != list_end(&job_list); e = list_next(e))
-                    {
-                        struct job *jobs = list_entry(e, struct job, elem);
-                        if (jobs->status != FOREGROUND)
-                        {
-                            print_job(jobs);
-                        }
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "exit") == 0)
-                {
-                    // Working as intended
-                    exit(0);
-                }
-                else if (strcmp(cmd->argv[0], "fg") == 0)
-                {
-                    // Use either atoi or strol per discord
-                    // Converting string to int
-                    int jid = atoi(cmd->argv[1]);
-                    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
-                    {
-                        struct job *job = get_job_from_jid(jid);
-                        if (job)
-                        {
-                            // Give the terminal to the job
-                            termstate_give_terminal_to(&job->saved_tty_state, job->pgid);
-                            // Continue job if it was stopped (accounts for user ^Z)
-                            if (job->status != FOREGROUND)
-                            {
-                                killpg(job->pgid, SIGCONT);
-                            }
-                            // Set status to foreground
-                            job->status = FOREGROUND;
-                            // Print out info to terminal (for tests)
-                            print_cmdline(job->pipe);
-                            printf(")\n");
-                            wait_for_job(job);
-                            // Give the terminal back to the shell
-                            termstate_give_terminal_back_to_shell();
-                        }
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "bg") == 0)
-                {
-                    // Converting string to int
-                    int jid = atoi(cmd->argv[1]);
-                    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
-                    {
-                        struct job *job = get_job_from_jid(jid);
-                        // Continue job if it was stopped (accounts for user ^Z)
-                        if (job && job->status != BACKGROUND)
-                        {
-                            killpg(job->pgid, SIGCONT);
-                            // Set status to background
-                            job->status = BACKGROUND;
-                        }
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "kill") == 0)
-                {
-                    // Converting string to int
-                    int jid = atoi(cmd->argv[1]);
-                    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
-                    {
-                        struct job *job = get_job_from_jid(jid);
-                        if (job)
-                        {
-                            // Terminate job
-                            killpg(job->pgid, SIGTERM);
-                        }
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "stop") == 0)
-                {
-                    // Converting string to int
-                    int jid = atoi(cmd->argv[1]);
-                    if (jid > 0 && jid < MAXJOBS && jid2job[jid] != NULL)
-                    {
-                        struct job *job = get_job_from_jid(jid);
-                        if (job)
-                        {
-                            // Stop job
-                            killpg(job->pgid, SIGSTOP);
-                        }
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "cd") == 0)
-                {
-                    if (cmd->argv[1] != NULL)
-                    {
-                        if (strcmp(cmd->argv[1], "-") == 0)
-                        {
-                            // Calling utility function for 'cd -' case
-                            if (prev_dir)
-                            {
-                                update_directory(prev_dir);
-                                printf("%s\n", current_dir);
-                            }
-                        }
-                        update_directory(cmd->argv[1]);
-                    }
-                    else
-                    {
-                        // Go to home directory if user does not specify
-                        update_directory(getenv("HOME"));
-                    }
-                }
-                else if (strcmp(cmd->argv[0], "history") == 0)
-                {
-                    // Referenced https://linux.die.net/man/3/history
-                    // History list
-                    HIST_ENTRY **the_history_list = history_list();
-                    int i = 0;
-                    // Loop through list and print (entry number, command)
-                    while (the_history_list[i] != NULL)
-                    {
-                        // history_base is entry position stored in zero based index
-                        int entry = history_base + i;
-                        // 'line' contains the command string
-                        char *command = the_history_list[i]->line;
-                        printf("    %d %s\n", entry, command);
-                        i++;
-                    }
-                }
-                else
-                {
-                    // Handling non built in functions
-                    struct list_elem *e = list_begin(&pipeline->commands);
-                    // Ensure there is at least one command
-                    if (e != list_end(&pipeline->commands))
-                    {
-                        // struct ast_command *cmd = list_entry(e, struct ast_command, elem);
-
-                        pid_t pid;
-                        posix_spawn_file_actions_t file;
-                        posix_spawn_file_actions_init(&file);
-
-                        //check on first pipe command if its reading from an input file
-                        if (cmd_elem == list_begin(&pipeline->commands) && pipeline->iored_input) {
-                            posix_spawn_file_actions_addopen(&file, STDIN_FILENO, pipeline->iored_input, O_RDONLY, 0666);
-                        }
-                        //check on last pipe command if output should be written or appended to an output file
-                        if (list_next(cmd_elem) == list_end(&pipeline->commands) && pipeline->iored_output) {
-                            if (pipeline->append_to_output)
-                            {
-                                // open(pipeline->iored_output, O_WRONLY | O_APPEND | O_CREAT, 0644);
-                                posix_spawn_file_actions_addopen(&file, STDOUT_FILENO, pipeline->iored_output, O_WRONLY | O_APPEND | O_CREAT, 0644);
-                            }
-                            else
-                            {
-                                // open(pipeline->iored_output, O_WRONLY | O_TRUNC | O_CREAT, 0644);
-                                posix_spawn_file_actions_addopen(&file, STDOUT_FILENO, pipeline->iored_output, O_WRONLY | O_TRUNC | O_CREAT, 0644);
-                            }
-                        }
-
-                        //first go through
-                        if (cmd_elem == list_begin(&pipeline->commands) && list_next(cmd_elem) != list_end(&pipeline->commands)) {
-                            piped = true;
-                            pipe2(fds, O_CLOEXEC);
-                            posix_spawn_file_actions_adddup2(&file, fds[1], STDOUT_FILENO);
-                            close1 = fds[1];
-                        }
-                        //middle stages
-                        else if (cmd_elem != list_begin(&pipeline->commands) && list_next(cmd_elem) != list_end(&pipeline->commands)) {
-                            close(close1);
-                            if (close0 != -1) {
-                                close(close0);
-                            }
-                            posix_spawn_file_actions_adddup2(&file, fds[0], STDIN_FILENO);
-                            close0 = fds[0];
-                            pipe2(fds2, O_CLOEXEC);
-                            posix_spawn_file_actions_adddup2(&file, fds2[1], STDOUT_FILENO);
-                            close1 = fds2[1];
-                            //close(fds[1]);
-                            fds[1] = fds2[1];
-                            fds[0] = fds2[0];
-                        }
-                        //last go through where it is a pipe
-                        else if (cmd_elem != list_begin(&pipeline->commands) && list_next(cmd_elem) == list_end(&pipeline->commands)) {
-                            close(close1);
-                            if (close0 !=  -1) {
-                                close(close0);
-                            }
-                            posix_spawn_file_actions_adddup2(&file, fds[0], STDIN_FILENO);
-                        }
-
-                        // printf("Executing command: %s\n", cmd->argv[0]);
-
-                        if (cmd->dup_stderr_to_stdout) {
-                            posix_spawn_file_actions_adddup2(&file, STDOUT_FILENO, STDERR_FILENO);
-                        }
-
-                        posix_spawnattr_t attr;
-                        posix_spawnattr_init(&attr);
-
-                        if (pipeline->bg_job)
-                        {
-                            job->status = BACKGROUND;
-                            posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_USEVFORK);
-                        }
-
-                        if (!pipeline->bg_job)
-                        {
-                            job->status = FOREGROUND;
-                            // Using 0x100 instead of 'POSIX_SPAWN_TCSETPGROUP' per forum post
-                            posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_USEVFORK | 0x100);
-                        }
-                        
-                        if (posix_spawnp(&pid, cmd->argv[0], &file, &attr, cmd->argv, environ) != 0)
-                        {
-                            perror("spawn failed");
-                        }
-                        else
-                        {
-                            if (job)
-                            {
-                                // Initalize pid of job
-                                struct pid_mult *job_pid = malloc(sizeof(struct pid_mult));
-                                job_pid->pid2 = pid;
-                                // Add to end of pid list
-                                list_push_back(&job->pid_list, &job_pid->mult_elem);
-                                // Set pgid
-                                if(job->num_processes_alive == 0)
-                                {
-                                    job->pgid = pid;
-                                }
-                                else
-                                {
-                                    setpgid(pid, job->pgid);
-                                }
-                                // Update process count
-                                job->num_processes_alive++;
-                                // Print out info if background job
-                                if (job->status == BACKGROUND)
-                                {
-                                    printf("[%d] %d\n", job->jid, pid);
-                                    termstate_save(&job->saved_tty_state);
-                                }
-                            }
-                            else 
-                            {
-                                delete_completed_jobs();
-                            }
-                        }
-                        posix_spawn_file_actions_destroy(&file);
-                        posix_spawnattr_destroy(&attr);
-                    }
-                }
-            }
-            if (piped) {
-                close(fds[1]);
-                close(fds[0]);
-            }
-            wait_for_job(job);
-            signal_unblock(SIGCHLD);
-            termstate_give_terminal_back_to_shell();
+        // Run the statements of the line
+        struct bc_program prog;
+        if (bc_compile(&prog, cline->stmts))
+        {
+            bc_run(&prog, &vm_ops, cline, &last_status);
+            bc_free(&prog);
         }
+        else
+            fprintf(stderr, "cush: command line too long\n");
 
         // ast_command_line_print(cline); /* Output a representation of
         //                                   the entered command line */
 
-        /* Free the command line.
-         * This will free the ast_pipeline objects still contained
-         * in the ast_command_line.  Once you implement a job list
-         * that may take ownership of ast_pipeline objects that are
-         * associated with jobs you will need to reconsider how you
-         * manage the lifetime of the associated ast_pipelines.
-         * Otherwise, freeing here will cause use-after-free errors.
+        /* Drop the parser's reference to the command line.  Jobs that
+         * are still running hold their own, so its arena is released
+         * when the last of them is deleted.
          */
-        //  ast_command_line_free(cline);
+        ast_command_line_free(cline);
     }
-    return 0;
+    // A script's status is that of its last command
+    return interactive ? 0 : last_status;
 }
@@ -1,3 +1,15 @@
 = Tests for Custom Features
 1 cd_test.py
-1 history_test.py
\ No newline at end of file
+1 history_test.py
+1 jobs_mem_test.py
+1 hash_test.py
+1 pin_test.py
+1 ulimit_test.py
+1 pipesize_test.py
+1 script_test.py
+1 control_test.py
+1 setsid_test.py
+1 fd_limit_test.py
+1 time_test.py
+1 jobs_long_test.py
+1 line_cache_test.py
\ No newline at end of file
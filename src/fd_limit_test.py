@@ -0,0 +1,51 @@
+#
+# Tests many background jobs under a low limit on open files
+#
+# Checks that the jobs the shell keeps track of do not hold on to file
+# descriptors, so that spawning does not fail once there are more of
+# them than the shell may open files.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. Lower the shell's own limit
+#
+sendline("ulimit -S -n 40")
+expect_prompt("Shell did not print expected prompt after ulimit")
+
+# Step 2. Start more background jobs than that, with two stages each
+#
+njobs = 45
+for i in range(njobs):
+    sendline("sleep 5 | sleep 5 &")
+    parse_bg_status()
+    expect_prompt("Shell did not print expected prompt after background job")
+
+# Step 3. All of them are running
+#
+sendline("jobs")
+for i in range(njobs):
+    job = parse_job_line()
+    assert job.status == "running", "Expected job %s to be running" % job.id
+expect_prompt("Shell did not print expected prompt after jobs")
+
+# Step 4. A foreground job still runs
+#
+sendline("echo spawned | tr a-z A-Z")
+expect_exact("SPAWNED", "Expected a foreground job to run")
+expect_prompt("Shell did not print expected prompt after echo")
+
+#################################################################
+
+test_success()
@@ -0,0 +1,56 @@
+#
+# Tests the 'hash' and 'type' builtins
+#
+# Checks that commands are remembered after they run, that 'hash -r'
+# forgets them, and that 'type' tells builtins from commands on PATH.
+#
+import atexit, proc_check, time
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. Nothing has been looked up yet
+#
+sendline("hash")
+expect_exact("hash: hash table empty", "Expected an empty hash table")
+expect_prompt("Shell did not print expected prompt after hash")
+
+# Step 2. Running a command twice remembers where it was found
+#
+sendline("true")
+expect_prompt()
+sendline("true")
+expect_prompt()
+sendline("hash")
+expect(r"\s+2\s+/\S+/true\r\n", "Expected true to be hashed with 2 hits")
+expect_prompt("Shell did not print expected prompt after hash")
+
+# Step 3. type reports hashed commands and builtins
+#
+sendline("type true")
+expect(r"true is hashed \(/\S+/true\)", "Expected true to be reported as hashed")
+expect_prompt()
+sendline("type cd")
+expect_exact("cd is a shell builtin", "Expected cd to be reported as a builtin")
+expect_prompt()
+
+# Step 4. hash -r forgets everything
+#
+sendline("hash -r")
+expect_prompt()
+sendline("hash")
+expect_exact("hash: hash table empty", "Expected hash -r to empty the table")
+expect_prompt("Shell did not print expected prompt after hash")
+
+#################################################################
+
+test_success()
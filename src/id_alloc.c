@@ -0,0 +1,94 @@
+/*
+ * id_alloc - hand out the lowest free id in logarithmic time.
+ *
+ * Used by the shell to assign job ids without sweeping the job table.
+ */
+#include <stdlib.h>
+#include <assert.h>
+
+#include "id_alloc.h"
+#include "utils.h"
+
+/* Initialize an allocator whose ids start at 'first' */
+void
+id_alloc_init(struct id_alloc *ids, int first)
+{
+    ids->heap = NULL;
+    ids->nfree = ids->capacity = 0;
+    ids->first = ids->next = first;
+}
+
+/* Release the memory held by the allocator */
+void
+id_alloc_destroy(struct id_alloc *ids)
+{
+    free(ids->heap);
+    id_alloc_init(ids, ids->first);
+}
+
+static inline void
+swap(int *a, int *b)
+{
+    int t = *a;
+    *a = *b;
+    *b = t;
+}
+
+/* Return the lowest id that is not in use and mark it as used */
+int
+id_alloc_get(struct id_alloc *ids)
+{
+    if (ids->nfree == 0)
+        return ids->next++;
+
+    /* Pop the minimum and sift the last element down. */
+    int *h = ids->heap;
+    int id = h[0];
+    h[0] = h[--ids->nfree];
+    for (size_t i = 0;;) {
+        size_t l = 2 * i + 1, r = l + 1, min = i;
+        if (l < ids->nfree && h[l] < h[min])
+            min = l;
+        if (r < ids->nfree && h[r] < h[min])
+            min = r;
+        if (min == i)
+            break;
+        swap(&h[i], &h[min]);
+        i = min;
+    }
+    return id;
+}
+
+/* Return an id previously obtained from id_alloc_get */
+void
+id_alloc_put(struct id_alloc *ids, int id)
+{
+    assert(id >= ids->first && id < ids->next);
+
+    /* The most recently handed out id need not enter the heap. */
+    if (id == ids->next - 1) {
+        ids->next--;
+        /* Once every id is free, start over from scratch. */
+        if ((size_t) (ids->next - ids->first) == ids->nfree) {
+            ids->nfree = 0;
+            ids->next = ids->first;
+        }
+        return;
+    }
+
+    if (ids->nfree == ids->capacity) {
+        ids->capacity = ids->capacity ? 2 * ids->capacity : 16;
+        ids->heap = realloc(ids->heap, ids->capacity * sizeof *ids->heap);
+        if (ids->heap == NULL)
+            utils_fatal_error("cannot grow id allocator: ");
+    }
+
+    /* Append and sift up. */
+    int *h = ids->heap;
+    size_t i = ids->nfree++;
+    h[i] = id;
+    while (i > 0 && h[(i - 1) / 2] > h[i]) {
+        swap(&h[(i - 1) / 2], &h[i]);
+        i = (i - 1) / 2;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __ID_ALLOC_H
+#define __ID_ALLOC_H
+
+#include <stddef.h>
+
+/* Allocator for small integer ids that always hands out the lowest
+ * id not currently in use, like the job ids of a job control shell.
+ *
+ * Ids at or above 'next' have never been handed out (or were
+ * returned in order from the top).  Ids below 'next' that have been
+ * returned are kept in a binary min-heap, so both allocating and
+ * releasing an id take O(log n) time.
+ */
+struct id_alloc {
+    int *heap;                  /* released ids below next, min-heap */
+    size_t nfree;               /* number of ids in heap */
+    size_t capacity;            /* allocated size of heap */
+    int first;                  /* lowest id ever handed out */
+    int next;                   /* lowest id never handed out */
+};
+
+/* Initialize an allocator whose ids start at 'first' */
+void id_alloc_init(struct id_alloc *ids, int first);
+
+/* Release the memory held by the allocator */
+void id_alloc_destroy(struct id_alloc *ids);
+
+/* Return the lowest id that is not in use and mark it as used */
+int id_alloc_get(struct id_alloc *ids);
+
+/* Return an id previously obtained from id_alloc_get */
+void id_alloc_put(struct id_alloc *ids, int id);
+
+#endif /* __ID_ALLOC_H */
@@ -0,0 +1,43 @@
+#
+# Tests 'jobs -l'
+#
+# Checks that each process of a background pipeline is listed with its
+# pid, whether it is still running and, once it has exited, the
+# resources it used, followed by the total for the job.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. A background pipeline whose first stage exits right away
+#
+sendline("true | sleep 5 &")
+jid, first = parse_bg_status()
+jid, second = parse_bg_status()
+expect_prompt("Shell did not print expected prompt after background job")
+time.sleep(0.5)
+
+# Step 2. Both stages are listed, the first one with its usage
+#
+sendline("jobs -l")
+job = parse_job_line()
+assert job.status == "running", "Expected the job to be running"
+expect(r"\t%s\tdone +user \d+\.\d{3}s  sys \d+\.\d{3}s  maxrss \d+K  ctxsw \d+/\d+\t\(true\)\r\n" % first,
+       "Expected true to be listed as done, with its usage")
+expect(r"\t%s\trunning \t\(sleep\)\r\n" % second, "Expected sleep to be listed as running")
+expect(r"\ttotal\tuser \d+\.\d{3}s  sys \d+\.\d{3}s  maxrss \d+K", "Expected the total for the job")
+expect_prompt("Shell did not print expected prompt after jobs -l")
+
+#################################################################
+
+test_success()
@@ -0,0 +1,47 @@
+#
+# Tests the 'jobs --mem' allocator report
+#
+# Checks that the job and pid_mult objects of finished jobs are
+# returned to their slab caches.
+#
+import atexit, proc_check, time
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. Start two background jobs, one of them a pipeline
+#
+sendline("sleep 1 &")
+parse_bg_status()
+expect_prompt()
+sendline("sleep 1 | sleep 1 &")
+parse_bg_status()
+parse_bg_status()
+expect_prompt()
+
+# Step 2. All three processes should be accounted for
+#
+sendline("jobs --mem")
+expect_exact("pid_mult:\t3 live", "Expected 3 live pid_mult objects")
+expect_prompt("Shell did not print expected prompt after jobs --mem")
+
+# Step 3. Once the jobs are done, their objects must be freed
+#
+time.sleep(1.5)
+sendline("jobs --mem")
+expect_exact("job:\t1 live", "Expected only the running 'jobs' job to be live")
+expect_exact("pid_mult:\t0 live", "Expected no live pid_mult objects")
+expect_prompt("Shell did not print expected prompt after jobs --mem")
+
+#################################################################
+
+test_success()
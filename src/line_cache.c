@@ -0,0 +1,95 @@
+/*
+ * line_cache - remember the parsed form of recently run command lines.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_cache.h"
+#include "utils.h"
+
+/* FNV-1a */
+static uint32_t
+hash_text(const char *text, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char) text[i]) * 16777619u;
+    return h;
+}
+
+static void
+free_entry(struct line_cache_entry *entry)
+{
+    ast_command_line_free(entry->line);
+    free(entry->text);
+    free(entry);
+}
+
+/* Initialize an empty cache that keeps at most 'capacity' lines */
+void
+line_cache_init(struct line_cache *cache, size_t capacity)
+{
+    cache->parser = ast_parser_create();
+    if (cache->parser == NULL)
+        utils_fatal_error("cannot create parser: ");
+    list_init(&cache->lines);
+    cache->count = 0;
+    cache->capacity = capacity;
+    cache->hits = cache->misses = 0;
+}
+
+/* Free all lines and the parser */
+void
+line_cache_destroy(struct line_cache *cache)
+{
+    while (!list_empty(&cache->lines))
+        free_entry(list_entry(list_pop_front(&cache->lines), struct line_cache_entry, elem));
+    cache->count = 0;
+    ast_parser_destroy(cache->parser);
+}
+
+/* Return the parsed form of 'text' */
+struct ast_command_line *
+line_cache_parse(struct line_cache *cache, const char *text, size_t len)
+{
+    uint32_t hash = hash_text(text, len);
+
+    for (struct list_elem *e = list_begin(&cache->lines); e != list_end(&cache->lines); e = list_next(e)) {
+        struct line_cache_entry *entry = list_entry(e, struct line_cache_entry, elem);
+        if (entry->hash != hash || entry->len != len || memcmp(entry->text, text, len) != 0)
+            continue;
+
+        list_remove(e);
+        list_push_front(&cache->lines, e);
+        cache->hits++;
+        return ast_command_line_ref(entry->line);
+    }
+
+    cache->misses++;
+    struct ast_command_line *line = ast_parser_parse(cache->parser, text, len);
+    if (line == NULL || cache->capacity == 0)
+        return line;
+
+    struct line_cache_entry *entry = malloc(sizeof *entry);
+    if (entry == NULL || (entry->text = malloc(len + 1)) == NULL)
+        utils_fatal_error("cannot allocate line cache entry: ");
+    memcpy(entry->text, text, len);
+    entry->len = len;
+    entry->hash = hash;
+    entry->line = line;
+    list_push_front(&cache->lines, &entry->elem);
+    if (++cache->count > cache->capacity) {
+        free_entry(list_entry(list_pop_back(&cache->lines), struct line_cache_entry, elem));
+        cache->count--;
+    }
+    return ast_command_line_ref(line);
+}
+
+/* Print a one-line summary of cache statistics */
+void
+line_cache_print(struct line_cache *cache)
+{
+    printf("parsed lines:\t%zu cached, %lu hits, %lu misses\n",
+           cache->count, cache->hits, cache->misses);
+}
@@ -0,0 +1,51 @@
+#ifndef __LINE_CACHE_H
+#define __LINE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "shell-ast.h"
+
+/* Parsed command lines, keyed by their text.  Shells run the same lines
+ * over and over, from the history or in the loops of scripts; a line
+ * found here is shared instead of being parsed again.  Parsed lines
+ * are never changed, so each user simply holds a reference.
+ */
+struct line_cache_entry {
+    struct list_elem elem;      /* in line_cache.lines */
+    char *text;
+    size_t len;
+    uint32_t hash;              /* of the text */
+    struct ast_command_line *line;
+};
+
+/* Lines parsed recently, most recently used first */
+struct line_cache {
+    struct ast_parser *parser;  /* for lines not found */
+    struct list lines;
+    size_t count;
+    size_t capacity;
+
+    /* statistics */
+    unsigned long hits;         /* lines that did not need to be parsed */
+    unsigned long misses;       /* lines that were parsed */
+};
+
+/* Initialize an empty cache that keeps at most 'capacity' lines */
+void line_cache_init(struct line_cache *cache, size_t capacity);
+
+/* Free all lines and the parser */
+void line_cache_destroy(struct line_cache *cache);
+
+/* Return the parsed form of the 'len' characters at 'text', parsing
+ * them unless they are cached.  The caller owns a reference to the
+ * result and drops it with ast_command_line_free.  Lines with errors
+ * are not cached, so that the error is reported each time; NULL is
+ * returned for them. */
+struct ast_command_line *line_cache_parse(struct line_cache *cache, const char *text, size_t len);
+
+/* Print a one-line summary of cache statistics */
+void line_cache_print(struct line_cache *cache);
+
+#endif /* __LINE_CACHE_H */
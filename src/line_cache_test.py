@@ -0,0 +1,54 @@
+#
+# Tests the cache of parsed command lines
+#
+# Checks with 'stats' that a line is parsed the first time it is run
+# and found in the cache the second time.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+stats_regex = r"parsed lines:\t\d+ cached, (\d+) hits, (\d+) misses\r\n"
+
+def parsed_lines():
+    sendline("stats")
+    hits, misses = expect_regex(stats_regex)
+    expect_prompt("Shell did not print expected prompt after stats")
+    return int(hits), int(misses)
+
+# 'stats' counts its own line too: a miss the first time, then a hit
+parsed_lines()
+
+# Step 1. A new line is a miss
+#
+hits, misses = parsed_lines()
+sendline("echo cached line | tr a-z A-Z")
+expect_exact("CACHED LINE", "Expected the line to run")
+expect_prompt("Shell did not print expected prompt after echo")
+after = parsed_lines()
+assert after == (hits + 1, misses + 1), \
+    "Expected one miss for the new line, got %s after %s" % (after, (hits, misses))
+
+# Step 2. The same line again is a hit
+#
+hits, misses = after
+sendline("echo cached line | tr a-z A-Z")
+expect_exact("CACHED LINE", "Expected the line to run again")
+expect_prompt("Shell did not print expected prompt after echo")
+after = parsed_lines()
+assert after == (hits + 2, misses), \
+    "Expected one hit for the same line, got %s after %s" % (after, (hits, misses))
+
+#################################################################
+
+test_success()
@@ -0,0 +1,105 @@
+/*
+ * line_reader - split a script into lines with few reads and no copies.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "line_reader.h"
+#include "utils.h"
+
+/* Read lines from 'fd' */
+void
+line_reader_init_fd(struct line_reader *reader, int fd)
+{
+    reader->fd = fd;
+    reader->size = LINE_READER_CHUNK + 1;
+    reader->buf = malloc(reader->size);
+    if (reader->buf == NULL)
+        utils_fatal_error("cannot allocate line buffer: ");
+    reader->start = reader->end = 0;
+}
+
+/* Read the lines of a copy of 's' */
+void
+line_reader_init_string(struct line_reader *reader, const char *s)
+{
+    reader->fd = -1;
+    reader->end = strlen(s);
+    reader->size = reader->end + 1;
+    reader->buf = malloc(reader->size);
+    if (reader->buf == NULL)
+        utils_fatal_error("cannot allocate line buffer: ");
+    memcpy(reader->buf, s, reader->end);
+    reader->start = 0;
+}
+
+/* Read more input after the unread part of the buffer, first moving it
+ * to the front or growing the buffer to make room for a chunk.  Returns
+ * false at EOF. */
+static bool
+fill(struct line_reader *reader)
+{
+    if (reader->fd == -1)
+        return false;
+
+    size_t unread = reader->end - reader->start;
+    memmove(reader->buf, reader->buf + reader->start, unread);
+    reader->start = 0;
+    reader->end = unread;
+
+    // Keep a byte free to terminate a last line without a newline
+    if (reader->size - reader->end < LINE_READER_CHUNK + 1) {
+        reader->size = reader->end + LINE_READER_CHUNK + 1;
+        reader->buf = realloc(reader->buf, reader->size);
+        if (reader->buf == NULL)
+            utils_fatal_error("cannot allocate line buffer: ");
+    }
+
+    ssize_t n;
+    do {
+        n = read(reader->fd, reader->buf + reader->end, reader->size - reader->end - 1);
+    } while (n == -1 && errno == EINTR);
+
+    if (n <= 0) {
+        reader->fd = -1;
+        return false;
+    }
+    reader->end += n;
+    return true;
+}
+
+/* Return the next line, or NULL at the end of the input */
+char *
+line_reader_next(struct line_reader *reader, size_t *len)
+{
+    size_t scanned = 0;     /* bytes already known to hold no newline */
+    char *nl;
+
+    while ((nl = memchr(reader->buf + reader->start + scanned, '\n',
+                        reader->end - reader->start - scanned)) == NULL) {
+        scanned = reader->end - reader->start;
+        if (!fill(reader)) {
+            if (scanned == 0)
+                return NULL;
+            // The last line has no newline
+            nl = reader->buf + reader->end;
+            break;
+        }
+    }
+
+    char *line = reader->buf + reader->start;
+    *nl = '\0';
+    *len = nl - line;
+    reader->start = nl - reader->buf + (nl < reader->buf + reader->end);
+    return line;
+}
+
+/* Free the buffer */
+void
+line_reader_destroy(struct line_reader *reader)
+{
+    free(reader->buf);
+    reader->buf = NULL;
+}
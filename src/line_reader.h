@@ -0,0 +1,37 @@
+#ifndef __LINE_READER_H
+#define __LINE_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LINE_READER_CHUNK 65536     /* bytes read at a time */
+
+/* Splits a script, read from a file descriptor or given as a string,
+ * into lines.  Input is read in large chunks into one buffer, and
+ * lines are handed out in place, so reading a line costs neither a
+ * system call nor a copy most of the time.  The buffer grows to hold
+ * lines longer than a chunk.
+ */
+struct line_reader {
+    int fd;                 /* -1 for a string, or once EOF was seen */
+    char *buf;
+    size_t size;            /* capacity of buf */
+    size_t start;           /* buf[start..end) has not been handed out */
+    size_t end;
+};
+
+/* Read lines from 'fd', which the reader does not close */
+void line_reader_init_fd(struct line_reader *reader, int fd);
+
+/* Read the lines of a copy of 's' */
+void line_reader_init_string(struct line_reader *reader, const char *s);
+
+/* Return the next line without its newline, NUL-terminated, and store
+ * its length in *len.  The line stays valid until the next call.
+ * Returns NULL at the end of the input or after a read error. */
+char *line_reader_next(struct line_reader *reader, size_t *len);
+
+/* Free the buffer */
+void line_reader_destroy(struct line_reader *reader);
+
+#endif /* __LINE_READER_H */
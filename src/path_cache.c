@@ -0,0 +1,348 @@
+/*
+ * path_cache - remember where commands were found on PATH.
+ *
+ * Implements the shell's 'hash' table, in the spirit of bash's.
+ */
+#define _GNU_SOURCE 1
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "path_cache.h"
+#include "utils.h"
+
+#define PATH_CACHE_MIN_BUCKETS 64
+
+/* What execvpe searches if PATH is unset */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+/* Changes to a PATH directory that may change what a name resolves to */
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+                      | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static char *
+xstrdup(const char *s)
+{
+    char *copy = strdup(s);
+    if (copy == NULL)
+        utils_fatal_error("cannot allocate path cache entry: ");
+    return copy;
+}
+
+/* FNV-1a */
+static size_t
+bucket_of(const struct path_cache *cache, const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) name; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h & (cache->nbuckets - 1);
+}
+
+static const char *
+current_path(void)
+{
+    const char *path = getenv("PATH");
+    return path != NULL ? path : DEFAULT_PATH;
+}
+
+/* Search PATH for an executable named 'name'.  An empty entry stands
+ * for the current directory.  If 'absolute_only', give up at the first
+ * entry that is not an absolute directory: from there on, what is
+ * found depends on the current directory, so it must not be cached. */
+static char *
+search_path(const char *name, bool absolute_only)
+{
+    if (*name == '\0' || strchr(name, '/') != NULL)
+        return NULL;
+
+    const char *path = current_path();
+    size_t namelen = strlen(name);
+    char *buf = malloc(strlen(path) + namelen + 3);
+    if (buf == NULL)
+        utils_fatal_error("cannot allocate path buffer: ");
+
+    for (const char *dir = path; ; dir++) {
+        const char *end = strchrnul(dir, ':');
+        size_t dirlen = end - dir;
+        if (dirlen == 0 || *dir != '/') {
+            if (absolute_only)
+                break;
+            if (dirlen == 0)
+                dir = ".", dirlen = 1;
+        }
+        memcpy(buf, dir, dirlen);
+        buf[dirlen] = '/';
+        memcpy(buf + dirlen + 1, name, namelen + 1);
+
+        struct stat st;
+        if (stat(buf, &st) == 0 && S_ISREG(st.st_mode) && access(buf, X_OK) == 0)
+            return buf;
+        if (*end == '\0')
+            break;
+        dir = end;
+    }
+    free(buf);
+    return NULL;
+}
+
+char *
+path_search(const char *name)
+{
+    return search_path(name, false);
+}
+
+/* Rehash all entries into new_nbuckets buckets */
+static void
+resize(struct path_cache *cache, size_t new_nbuckets)
+{
+    struct path_cache_entry **old = cache->buckets;
+    size_t old_nbuckets = cache->nbuckets;
+
+    cache->buckets = calloc(new_nbuckets, sizeof *cache->buckets);
+    if (cache->buckets == NULL)
+        utils_fatal_error("cannot allocate path cache: ");
+    cache->nbuckets = new_nbuckets;
+
+    for (size_t i = 0; i < old_nbuckets; i++) {
+        struct path_cache_entry *e, *next;
+        for (e = old[i]; e != NULL; e = next) {
+            next = e->next;
+            size_t b = bucket_of(cache, e->name);
+            e->next = cache->buckets[b];
+            cache->buckets[b] = e;
+        }
+    }
+    free(old);
+}
+
+/* (Re)start watching every absolute directory on PATH */
+static void
+watch_path(struct path_cache *cache)
+{
+    if (cache->watch_fd != -1)
+        close(cache->watch_fd);
+
+    cache->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->watch_fd == -1)
+        return;         /* fall back to invalidating on PATH changes only */
+
+    char *path = xstrdup(cache->path_var);
+    char *saveptr;
+    for (char *dir = strtok_r(path, ":", &saveptr); dir != NULL;
+         dir = strtok_r(NULL, ":", &saveptr))
+        if (*dir == '/')
+            inotify_add_watch(cache->watch_fd, dir, WATCH_EVENTS | IN_ONLYDIR);
+    free(path);
+}
+
+/* Consume pending inotify events; return true if there were any */
+static bool
+drain_watch(int fd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof buf);
+        if (n > 0) {
+            changed = true;
+            continue;
+        }
+        if (n == -1 && errno == EINTR)
+            continue;
+        return changed;
+    }
+}
+
+/* Empty the cache if PATH, or a directory on it, changed since the
+ * entries were found */
+static void
+validate(struct path_cache *cache)
+{
+    const char *path = current_path();
+
+    if (cache->path_var == NULL || strcmp(path, cache->path_var) != 0) {
+        path_cache_clear(cache);
+        free(cache->path_var);
+        cache->path_var = xstrdup(path);
+        watch_path(cache);
+    } else if (cache->watch_fd != -1 && drain_watch(cache->watch_fd)) {
+        path_cache_clear(cache);
+    }
+}
+
+/* Initialize an empty cache */
+void
+path_cache_init(struct path_cache *cache)
+{
+    memset(cache, 0, sizeof *cache);
+    cache->watch_fd = -1;
+    resize(cache, PATH_CACHE_MIN_BUCKETS);
+}
+
+/* Release the memory held by a cache */
+void
+path_cache_destroy(struct path_cache *cache)
+{
+    path_cache_clear(cache);
+    free(cache->buckets);
+    free(cache->path_var);
+    if (cache->watch_fd != -1)
+        close(cache->watch_fd);
+    memset(cache, 0, sizeof *cache);
+    cache->watch_fd = -1;
+}
+
+static struct path_cache_entry **
+find_entry(struct path_cache *cache, const char *name)
+{
+    struct path_cache_entry **pe = &cache->buckets[bucket_of(cache, name)];
+    while (*pe != NULL && strcmp((*pe)->name, name) != 0)
+        pe = &(*pe)->next;
+    return pe;
+}
+
+/* Return the entry for command 'name', searching PATH and remembering
+ * the result if it is not cached. */
+struct path_cache_entry *
+path_cache_lookup_entry(struct path_cache *cache, const char *name)
+{
+    if (strchr(name, '/') != NULL)
+        return NULL;
+
+    validate(cache);
+    struct path_cache_entry *e = *find_entry(cache, name);
+    if (e != NULL) {
+        path_cache_reuse(cache, e);
+        return e;
+    }
+
+    cache->misses++;
+    // Names not found before a relative entry of PATH are left to
+    // posix_spawnp, which searches PATH itself every time
+    char *path = search_path(name, true);
+    if (path == NULL)
+        return NULL;
+
+    if (cache->count + 1 > cache->nbuckets)
+        resize(cache, 2 * cache->nbuckets);
+
+    e = malloc(sizeof *e);
+    if (e == NULL)
+        utils_fatal_error("cannot allocate path cache entry: ");
+    e->name = xstrdup(name);
+    e->path = path;
+    e->hits = 1;
+
+    size_t b = bucket_of(cache, name);
+    e->next = cache->buckets[b];
+    cache->buckets[b] = e;
+    cache->count++;
+    return e;
+}
+
+/* Return the absolute path of command 'name', searching PATH and
+ * remembering the result if it is not cached. */
+const char *
+path_cache_lookup(struct path_cache *cache, const char *name)
+{
+    struct path_cache_entry *e = path_cache_lookup_entry(cache, name);
+    return e != NULL ? e->path : NULL;
+}
+
+/* Return a number that changes whenever cache entries are freed */
+unsigned long
+path_cache_generation(struct path_cache *cache)
+{
+    validate(cache);
+    return cache->generation;
+}
+
+/* Count a use of an entry the caller kept from an earlier lookup */
+void
+path_cache_reuse(struct path_cache *cache, struct path_cache_entry *e)
+{
+    cache->hits++;
+    e->hits++;
+}
+
+/* Return the cached path of 'name', or NULL if 'name' is not cached */
+const char *
+path_cache_peek(struct path_cache *cache, const char *name)
+{
+    validate(cache);
+    struct path_cache_entry *e = *find_entry(cache, name);
+    return e != NULL ? e->path : NULL;
+}
+
+static void
+free_entry(struct path_cache_entry *e)
+{
+    free(e->name);
+    free(e->path);
+    free(e);
+}
+
+/* Forget where 'name' is */
+void
+path_cache_forget(struct path_cache *cache, const char *name)
+{
+    struct path_cache_entry **pe = find_entry(cache, name);
+    struct path_cache_entry *e = *pe;
+    if (e == NULL)
+        return;
+
+    *pe = e->next;
+    free_entry(e);
+    cache->count--;
+    cache->generation++;
+}
+
+/* Forget all remembered commands */
+void
+path_cache_clear(struct path_cache *cache)
+{
+    if (cache->count > 0)
+        cache->flushes++;
+
+    for (size_t i = 0; i < cache->nbuckets; i++) {
+        struct path_cache_entry *e, *next;
+        for (e = cache->buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            free_entry(e);
+        }
+        cache->buckets[i] = NULL;
+    }
+    cache->count = 0;
+    cache->generation++;
+}
+
+/* Print the remembered commands in the format of bash's 'hash' */
+void
+path_cache_print(struct path_cache *cache)
+{
+    validate(cache);
+    if (cache->count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < cache->nbuckets; i++)
+        for (struct path_cache_entry *e = cache->buckets[i]; e != NULL; e = e->next)
+            printf("%4lu\t%s\n", e->hits, e->path);
+}
+
+/* Print a one-line summary of cache statistics */
+void
+path_cache_print_stats(struct path_cache *cache)
+{
+    printf("command hash:\t%zu entries, %lu hits, %lu misses, %lu flushes\n",
+           cache->count, cache->hits, cache->misses, cache->flushes);
+}
@@ -0,0 +1,80 @@
+#ifndef __PATH_CACHE_H
+#define __PATH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A remembered command: where PATH search found 'name' */
+struct path_cache_entry {
+    struct path_cache_entry *next;      /* next entry in the same bucket */
+    char *name;
+    char *path;                 /* absolute path of the executable */
+    unsigned long hits;         /* times the entry was used */
+};
+
+/* Cache from a command name to its location on PATH, so that the
+ * shell searches PATH once per command rather than having execvpe
+ * try every directory in the spawned child each time.
+ *
+ * The cache is emptied when the value of PATH changes, and, if
+ * inotify is available, when a file is created, removed, renamed or
+ * has its mode changed in any directory on PATH.
+ */
+struct path_cache {
+    struct path_cache_entry **buckets;
+    size_t nbuckets;            /* a power of two */
+    size_t count;               /* number of entries */
+    char *path_var;             /* value of PATH the entries were found on */
+    int watch_fd;               /* inotify fd watching PATH, or -1 */
+    unsigned long generation;   /* changes whenever entries are freed */
+
+    /* statistics */
+    unsigned long hits;         /* lookups answered from the cache */
+    unsigned long misses;       /* lookups that searched PATH */
+    unsigned long flushes;      /* times the cache was emptied */
+};
+
+/* Initialize an empty cache */
+void path_cache_init(struct path_cache *cache);
+
+/* Release the memory held by a cache */
+void path_cache_destroy(struct path_cache *cache);
+
+/* Return the absolute path of command 'name', searching PATH and
+ * remembering the result if it is not cached.  Returns NULL if 'name'
+ * contains a slash or is not found. */
+const char *path_cache_lookup(struct path_cache *cache, const char *name);
+
+/* Like path_cache_lookup, but return the entry itself.  It remains
+ * valid for as long as path_cache_generation returns the same value. */
+struct path_cache_entry *path_cache_lookup_entry(struct path_cache *cache, const char *name);
+
+/* Empty the cache if PATH or a directory on it changed, then return a
+ * number that changes whenever cache entries are freed */
+unsigned long path_cache_generation(struct path_cache *cache);
+
+/* Count a use of an entry that the caller kept from an earlier lookup */
+void path_cache_reuse(struct path_cache *cache, struct path_cache_entry *e);
+
+/* Return the cached path of 'name' without searching PATH or counting
+ * a hit, or NULL if 'name' is not cached. */
+const char *path_cache_peek(struct path_cache *cache, const char *name);
+
+/* Forget where 'name' is, e.g. after its cached path failed to execute */
+void path_cache_forget(struct path_cache *cache, const char *name);
+
+/* Forget all remembered commands */
+void path_cache_clear(struct path_cache *cache);
+
+/* Print the remembered commands in the format of bash's 'hash' */
+void path_cache_print(struct path_cache *cache);
+
+/* Print a one-line summary of cache statistics */
+void path_cache_print_stats(struct path_cache *cache);
+
+/* Search PATH for an executable named 'name', as execvp would.
+ * Returns a malloc'd path, relative if it was found through a
+ * relative entry of PATH, or NULL if there is none. */
+char *path_search(const char *name);
+
+#endif /* __PATH_CACHE_H */
@@ -0,0 +1,133 @@
+/*
+ * pid_index - map process ids to processes in constant expected time.
+ *
+ * Used by the shell to find the job a reaped child belongs to
+ * without scanning every job's process list.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "pid_index.h"
+#include "utils.h"
+
+#define PID_INDEX_MIN_CAPACITY 64
+
+/* Fibonacci hashing spreads consecutive pids across the table. */
+static inline size_t
+slot_of(const struct pid_index *index, pid_t pid)
+{
+    return ((uint32_t) pid * 2654435769u) & (index->capacity - 1);
+}
+
+/* Place pid without checking the load factor */
+static void
+insert_slot(struct pid_index *index, pid_t pid, void *value)
+{
+    size_t i = slot_of(index, pid);
+    while (index->slots[i].pid != 0) {
+        assert(index->slots[i].pid != pid);
+        i = (i + 1) & (index->capacity - 1);
+    }
+    index->slots[i].pid = pid;
+    index->slots[i].value = value;
+    index->used++;
+}
+
+/* Rehash all entries into a table of new_capacity slots */
+static void
+resize(struct pid_index *index, size_t new_capacity)
+{
+    struct pid_index_slot *old = index->slots;
+    size_t old_capacity = index->capacity;
+
+    index->slots = calloc(new_capacity, sizeof *index->slots);
+    if (index->slots == NULL)
+        utils_fatal_error("cannot allocate pid index: ");
+    index->capacity = new_capacity;
+    index->used = 0;
+
+    for (size_t i = 0; i < old_capacity; i++)
+        if (old[i].pid != 0)
+            insert_slot(index, old[i].pid, old[i].value);
+    free(old);
+}
+
+/* Initialize an empty index */
+void
+pid_index_init(struct pid_index *index)
+{
+    index->slots = NULL;
+    index->capacity = 0;
+    index->used = 0;
+    resize(index, PID_INDEX_MIN_CAPACITY);
+}
+
+/* Release the memory held by an index */
+void
+pid_index_destroy(struct pid_index *index)
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = index->used = 0;
+}
+
+/* Map pid to value.  Keeps the load factor at or below 1/2. */
+void
+pid_index_insert(struct pid_index *index, pid_t pid, void *value)
+{
+    assert(pid > 0);
+    if (2 * (index->used + 1) > index->capacity)
+        resize(index, 2 * index->capacity);
+    insert_slot(index, pid, value);
+}
+
+/* Return the slot holding pid, or -1 if there is none */
+static ptrdiff_t
+find_slot(const struct pid_index *index, pid_t pid)
+{
+    size_t i = slot_of(index, pid);
+    while (index->slots[i].pid != 0) {
+        if (index->slots[i].pid == pid)
+            return i;
+        i = (i + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+/* Return the value mapped to pid, or NULL if there is none */
+void *
+pid_index_lookup(struct pid_index *index, pid_t pid)
+{
+    ptrdiff_t i = find_slot(index, pid);
+    return i < 0 ? NULL : index->slots[i].value;
+}
+
+/* Remove pid from the index.
+ * Entries following the removed one in its probe run are shifted
+ * back so that every entry stays reachable from its home slot. */
+void *
+pid_index_remove(struct pid_index *index, pid_t pid)
+{
+    ptrdiff_t found = find_slot(index, pid);
+    if (found < 0)
+        return NULL;
+
+    size_t mask = index->capacity - 1;
+    size_t hole = found;
+    void *value = index->slots[hole].value;
+
+    for (size_t i = (hole + 1) & mask; index->slots[i].pid != 0; i = (i + 1) & mask) {
+        size_t home = slot_of(index, index->slots[i].pid);
+        /* Move slot i into the hole unless its home lies
+         * cyclically within (hole, i]. */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].pid = 0;
+    index->slots[hole].value = NULL;
+    index->used--;
+    return value;
+}
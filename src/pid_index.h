@@ -0,0 +1,46 @@
+#ifndef __PID_INDEX_H
+#define __PID_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Open-addressing hash index from a process id to the shell's record
+ * of that process (and through it, the job that owns it).
+ *
+ * Slots are probed linearly; a slot whose pid is 0 is empty.
+ * Removal uses backward-shift deletion, so there are no tombstones
+ * and lookup cost does not degrade as processes come and go.
+ *
+ * pid_index_lookup and pid_index_remove never allocate memory and
+ * may therefore be called from a signal handler, provided that
+ * pid_index_insert is only ever called while that signal is blocked.
+ */
+struct pid_index_slot {
+    pid_t pid;                  /* 0 if the slot is empty */
+    void *value;                /* the record of this process */
+};
+
+struct pid_index {
+    struct pid_index_slot *slots;
+    size_t capacity;            /* number of slots, a power of two */
+    size_t used;                /* number of occupied slots */
+};
+
+/* Initialize an empty index */
+void pid_index_init(struct pid_index *index);
+
+/* Release the memory held by an index */
+void pid_index_destroy(struct pid_index *index);
+
+/* Map pid to value.  pid must be positive and not yet present. */
+void pid_index_insert(struct pid_index *index, pid_t pid, void *value);
+
+/* Return the value mapped to pid, or NULL if there is none */
+void *pid_index_lookup(struct pid_index *index, pid_t pid);
+
+/* Remove pid from the index.  Returns the value it was mapped to,
+ * or NULL if pid was not present. */
+void *pid_index_remove(struct pid_index *index, pid_t pid);
+
+#endif /* __PID_INDEX_H */
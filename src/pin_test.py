@@ -0,0 +1,46 @@
+#
+# Tests the 'pin' prefix
+#
+# Checks that a pinned command may only run on the CPUs it was given,
+# also when it is one stage of a pipeline, and that malformed CPU
+# lists are rejected.
+#
+import atexit, proc_check, time
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. A pinned command sees only CPU 0
+#
+sendline("pin 0 grep Cpus_allowed_list /proc/self/status")
+expect(r"Cpus_allowed_list:\s+0\r\n", "Expected the command to be pinned to CPU 0")
+expect_prompt("Shell did not print expected prompt after pin")
+
+# Step 2. Stages of a pipeline are pinned on their own
+#
+sendline("pin 0 grep Cpus_allowed_list /proc/self/status | cat")
+expect(r"Cpus_allowed_list:\s+0\r\n", "Expected the first stage to be pinned to CPU 0")
+expect_prompt("Shell did not print expected prompt after pin")
+
+# Step 3. Malformed CPU lists are rejected
+#
+sendline("pin 3-1 true")
+expect_exact("pin: usage:", "Expected a usage message for a malformed CPU list")
+expect_prompt("Shell did not print expected prompt after pin")
+
+sendline("type pin")
+expect_exact("pin is a shell keyword", "Expected pin to be reported as a keyword")
+expect_prompt()
+
+#################################################################
+
+test_success()
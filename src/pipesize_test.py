@@ -0,0 +1,54 @@
+#
+# Tests the 'pipesize' builtin and prefix
+#
+# Checks that 'pipesize size' in front of a pipeline sets the capacity
+# of its pipes, that 'pipesize' alone shows and changes the default,
+# and that sizes are capped at /proc/sys/fs/pipe-max-size.
+#
+import atexit, proc_check, time
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# F_GETPIPE_SZ on the standard output of the first stage
+getpipesz = "perl -e print(fcntl(STDOUT,1032,0),qq(\\n)) | cat"
+pipe_max = int(open("/proc/sys/fs/pipe-max-size").read())
+
+# Step 1. The default is the kernel's
+#
+sendline("pipesize")
+expect_exact("default", "Expected the default pipe size")
+expect_prompt("Shell did not print expected prompt after pipesize")
+
+# Step 2. A prefix sets the size for one pipeline only
+#
+sendline("pipesize 256K " + getpipesz)
+expect_exact("262144", "Expected a 256 KiB pipe")
+expect_prompt("Shell did not print expected prompt after pipeline")
+sendline(getpipesz)
+expect_exact("65536", "Expected the next pipeline to get a default pipe")
+expect_prompt("Shell did not print expected prompt after pipeline")
+
+# Step 3. pipesize alone changes the default, capped at pipe-max-size
+#
+sendline("pipesize 1000M")
+expect_prompt("Shell did not print expected prompt after pipesize")
+sendline("pipesize")
+expect_exact(str(pipe_max), "Expected the size to be capped at pipe-max-size")
+expect_prompt("Shell did not print expected prompt after pipesize")
+sendline(getpipesz)
+expect_exact(str(pipe_max), "Expected pipelines to use the new default")
+expect_prompt("Shell did not print expected prompt after pipeline")
+
+#################################################################
+
+test_success()
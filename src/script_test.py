@@ -0,0 +1,57 @@
+#
+# Tests running scripts: 'cush script', 'cush -c commands' and commands
+# piped into cush
+#
+# Checks that #! and comment lines are skipped, that builtins and
+# pipelines work, that the shell exits with the status of its last
+# command or the one given to 'exit', and that it runs without a
+# controlling terminal.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+fd, script = tempfile.mkstemp(suffix=".sh")
+atexit.register(os.unlink, script)
+os.write(fd, b"#!./cush\necho script | tr a-z A-Z\n  # a comment\ntype cd\nexit 3\necho not reached\n")
+os.close(fd)
+
+# Step 1. A script file, run from cush itself
+#
+sendline('sh -c "./cush ' + script + '; echo status=$?"')
+expect_exact("SCRIPT", "Expected the output of the pipeline")
+expect_exact("cd is a shell builtin", "Expected the output of the builtin")
+expect_exact("status=3", "Expected the status given to exit")
+expect_prompt("Shell did not print expected prompt after script")
+
+# Step 2. -c exits with the status of the last command
+#
+sendline('sh -c "./cush -c false; echo status=$?"')
+expect_exact("status=1", "Expected the status of false")
+expect_prompt("Shell did not print expected prompt after -c")
+
+# Step 3. Commands on standard input
+#
+sendline("echo ECHO PIPED | tr A-Z a-z | ./cush")
+expect_exact("piped", "Expected the piped command to run")
+expect_prompt("Shell did not print expected prompt after piped commands")
+
+# Step 4. No controlling terminal
+#
+sendline('setsid -w ./cush -c "echo detached | tr a-z A-Z"')
+expect_exact("DETACHED", "Expected the command to run without a terminal")
+expect_prompt("Shell did not print expected prompt after setsid")
+
+#################################################################
+
+test_success()
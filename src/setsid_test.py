@@ -0,0 +1,41 @@
+#
+# Tests a pipeline stage that leaves the job's process group
+#
+# Checks that the shell waits for a stage that calls setsid, instead
+# of failing once no process is left in the group, and then goes on.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. The last stage leaves the group
+#
+start = time.time()
+sendline("true | setsid sleep 1; echo after | tr a-z A-Z")
+expect_exact("AFTER", "Expected the shell to go on after the pipeline")
+assert time.time() - start >= 1, "Expected the shell to wait for the setsid stage"
+expect_prompt("Shell did not print expected prompt after setsid stage")
+
+# Step 2. The same in a script
+#
+fd, script = tempfile.mkstemp(suffix=".sh")
+atexit.register(os.unlink, script)
+os.write(fd, b"true | setsid sleep 0 | cat\necho script | tr a-z A-Z\n")
+os.close(fd)
+sendline("./cush " + script)
+expect_exact("SCRIPT", "Expected the script to go on")
+expect_prompt("Shell did not print expected prompt after script")
+
+#################################################################
+
+test_success()
@@ -10,32 +10,41 @@
 #include <sys/types.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 
 #include "shell-ast.h"
+#include "utils.h"
 
-/* Create new command structure.  Takes ownership of argv. */
+#define obstack_chunk_alloc malloc
+#define obstack_chunk_free free
+
+/* Create new command structure.  argv must live in the line's arena. */
 struct ast_command * 
-ast_command_create(char ** argv, bool dup_stderr_to_stdout)
+ast_command_create(struct ast_command_line *line, char ** argv, bool dup_stderr_to_stdout)
 {
-    struct ast_command *cmd = malloc(sizeof *cmd);
+    struct ast_command *cmd = obstack_alloc(&line->arena, sizeof *cmd);
 
     cmd->argv = argv;
+    cmd->quoted = NULL;
     cmd->dup_stderr_to_stdout = dup_stderr_to_stdout;
     return cmd;
 }
 
 /* Create a new pipeline */
-struct ast_pipeline * ast_pipeline_create(char *iored_input, 
+struct ast_pipeline * ast_pipeline_create(struct ast_command_line *line,
+                                          char *iored_input, 
                                           char *iored_output, 
                                           bool append_to_output)
 {
-    struct ast_pipeline *pipe = malloc(sizeof *pipe);
+    struct ast_pipeline *pipe = obstack_alloc(&line->arena, sizeof *pipe);
 
     list_init(&pipe->commands);
     pipe->iored_output = iored_output;
     pipe->iored_input = iored_input;
     pipe->append_to_output = append_to_output;
     pipe->bg_job = false;
+    pipe->quoted_input = pipe->quoted_output = false;
     return pipe;
 }
 
@@ -46,26 +55,186 @@ ast_pipeline_add_command(struct ast_pipeline *pipe, struct ast_command *cmd)
     list_push_back(&pipe->commands, &cmd->elem);
 }
 
+static void
+arena_exhausted(void)
+{
+    utils_fatal_error("cannot allocate command line: ");
+}
+
 /* Create an empty command line */
 struct ast_command_line *
-ast_command_line_create_empty(void)
+ast_command_line_create(void)
 {
     struct ast_command_line *cmdline = malloc(sizeof *cmdline);
+    if (cmdline == NULL)
+        arena_exhausted();
 
+    obstack_alloc_failed_handler = arena_exhausted;
+    obstack_init(&cmdline->arena);
     list_init(&cmdline->pipes);
+    cmdline->stmts = ast_stmts_create(cmdline);
+    cmdline->refcount = 1;
+    cmdline->words_from = NULL;
     return cmdline;
 }
 
-/* Create a command line with a single pipeline */
-struct ast_command_line *
-ast_command_line_create(struct ast_pipeline *pipe)
+/* Add a pipeline to the end of a command line */
+void
+ast_command_line_add_pipeline(struct ast_command_line *cmdline, struct ast_pipeline *pipe)
 {
-    struct ast_command_line *cmdline = ast_command_line_create_empty();
-
     list_push_back(&cmdline->pipes, &pipe->elem);
+}
+
+/* Take another reference to a command line */
+struct ast_command_line *
+ast_command_line_ref(struct ast_command_line *cmdline)
+{
+    cmdline->refcount++;
     return cmdline;
 }
 
+/* Copy a pipeline into another line, sharing its words */
+struct ast_pipeline *
+ast_pipeline_copy(struct ast_command_line *line, struct ast_pipeline *orig)
+{
+    return ast_pipeline_expand(line, orig, NULL);
+}
+
+/* Return the length of the name of the variable referred to by the '$'
+ * at 'p', including braces, or 0 if it does not start a reference */
+static size_t
+var_ref_length(const char *p)
+{
+    if (p[1] == '?')
+        return 1;
+
+    const char *name = p[1] == '{' ? p + 2 : p + 1;
+    if (!isalpha((unsigned char) *name) && *name != '_')
+        return 0;
+    size_t len = 1;
+    while (isalnum((unsigned char) name[len]) || name[len] == '_')
+        len++;
+    if (p[1] != '{')
+        return len;
+    return name[len] == '}' ? len + 2 : 0;
+}
+
+static bool
+word_has_vars(const char *word)
+{
+    for (const char *p = strchr(word, '$'); p != NULL; p = strchr(p + 1, '$'))
+        if (var_ref_length(p) > 0)
+            return true;
+    return false;
+}
+
+/* Return true if a word of the pipeline refers to a variable */
+bool
+ast_pipeline_has_vars(struct ast_pipeline *pipe)
+{
+    if ((pipe->iored_input && !pipe->quoted_input && word_has_vars(pipe->iored_input))
+        || (pipe->iored_output && !pipe->quoted_output && word_has_vars(pipe->iored_output)))
+        return true;
+
+    for (struct list_elem * e = list_begin(&pipe->commands); 
+         e != list_end(&pipe->commands); 
+         e = list_next(e)) {
+        struct ast_command *cmd = list_entry(e, struct ast_command, elem);
+        for (size_t i = 0; cmd->argv[i] != NULL; i++)
+            if (!(cmd->quoted && cmd->quoted[i]) && word_has_vars(cmd->argv[i]))
+                return true;
+    }
+    return false;
+}
+
+/* Return 'word' with its variables replaced, allocated from the arena
+ * of 'line' unless it has none or was quoted */
+static char *
+expand_word(struct ast_command_line *line, char *word, bool quoted,
+            const char *(*lookup)(const char *name))
+{
+    if (lookup == NULL || word == NULL || quoted || !word_has_vars(word))
+        return word;
+
+    struct obstack *arena = &line->arena;
+    char name[256];
+    for (char *p = word; *p != '\0'; ) {
+        size_t len = *p == '$' ? var_ref_length(p) : 0;
+        if (len == 0) {
+            obstack_1grow(arena, *p++);
+            continue;
+        }
+
+        // Skip '$' and, if there are braces, '{'; take what is left of len
+        const char *start = p[1] == '{' ? p + 2 : p + 1;
+        size_t namelen = p[1] == '{' ? len - 2 : len;
+        if (namelen >= sizeof name)
+            namelen = sizeof name - 1;
+        memcpy(name, start, namelen);
+        name[namelen] = '\0';
+
+        const char *value = lookup(name);
+        if (value != NULL)
+            obstack_grow(arena, value, strlen(value));
+        p += 1 + len;
+    }
+    obstack_1grow(arena, '\0');
+    return obstack_finish(arena);
+}
+
+/* Copy a pipeline, replacing the variables in its words */
+struct ast_pipeline *
+ast_pipeline_expand(struct ast_command_line *line, struct ast_pipeline *orig,
+                    const char *(*lookup)(const char *name))
+{
+    struct ast_pipeline *pipe = ast_pipeline_create(line, 
+                                                    expand_word(line, orig->iored_input, orig->quoted_input, lookup),
+                                                    expand_word(line, orig->iored_output, orig->quoted_output, lookup),
+                                                    orig->append_to_output);
+    pipe->bg_job = orig->bg_job;
+    pipe->quoted_input = orig->quoted_input;
+    pipe->quoted_output = orig->quoted_output;
+
+    for (struct list_elem * e = list_begin(&orig->commands); 
+         e != list_end(&orig->commands); 
+         e = list_next(e)) {
+        struct ast_command *ocmd = list_entry(e, struct ast_command, elem);
+        size_t argc = 0;
+        while (ocmd->argv[argc] != NULL)
+            argc++;
+
+        char **argv = obstack_alloc(&line->arena, (argc + 1) * sizeof *argv);
+        for (size_t i = 0; i < argc; i++)
+            argv[i] = expand_word(line, ocmd->argv[i], ocmd->quoted && ocmd->quoted[i], lookup);
+        argv[argc] = NULL;
+        struct ast_command *cmd = ast_command_create(line, argv, ocmd->dup_stderr_to_stdout);
+        cmd->quoted = ocmd->quoted;
+        ast_pipeline_add_command(pipe, cmd);
+    }
+    return pipe;
+}
+
+/* Create a statement */
+struct ast_node *
+ast_node_create(struct ast_command_line *line, enum ast_node_kind kind)
+{
+    struct ast_node *node = obstack_alloc(&line->arena, sizeof *node);
+
+    memset(node, 0, sizeof *node);
+    node->kind = kind;
+    return node;
+}
+
+/* Create an empty list of statements */
+struct list *
+ast_stmts_create(struct ast_command_line *line)
+{
+    struct list *stmts = obstack_alloc(&line->arena, sizeof *stmts);
+
+    list_init(stmts);
+    return stmts;
+}
+
 /* Print ast_command structure to stdout */
 void
 ast_command_print(struct ast_command *cmd)
@@ -128,42 +297,16 @@ ast_command_line_print(struct ast_command_line *cmdline)
     printf("==========================================\n");
 }
 
-/* Deallocation functions. */
+/* Deallocation function.  Nothing in the line is freed on its own;
+ * releasing the arena frees it all at once. */
 void 
 ast_command_line_free(struct ast_command_line *cmdline)
 {
-    for (struct list_elem * e = list_begin(&cmdline->pipes); e != list_end(&cmdline->pipes); ) {
-        struct ast_pipeline *pipe = list_entry(e, struct ast_pipeline, elem);
-        e = list_remove(e);
-        ast_pipeline_free(pipe);
-    }
-    free(cmdline);
-}
-
-void 
-ast_pipeline_free(struct ast_pipeline *pipe)
-{
-    for (struct list_elem * e = list_begin(&pipe->commands); e != list_end(&pipe->commands); ) {
-        struct ast_command *cmd = list_entry(e, struct ast_command, elem);
-        e = list_remove(e);
-        ast_command_free(cmd);
-    }
-    if (pipe->iored_input)
-        free(pipe->iored_input);
+    if (--cmdline->refcount > 0)
+        return;
 
-    if (pipe->iored_output)
-        free(pipe->iored_output);
-
-    free(pipe);
-}
-
-void 
-ast_command_free(struct ast_command * cmd)
-{
-    char ** p = cmd->argv;
-    while (*p) {
-        free(*p++);
-    }
-    free(cmd->argv);
-    free(cmd);
+    obstack_free(&cmdline->arena, NULL);
+    if (cmdline->words_from)
+        ast_command_line_free(cmdline->words_from);
+    free(cmdline);
 }
@@ -1,16 +1,53 @@
 #ifndef __SHELL_AST_H
 #define __SHELL_AST_H
 
+#include <obstack.h>
 #include "list.h"
 
 /* Forward declarations. */
 struct ast_command;
 struct ast_pipeline;
 struct ast_command_line;
+struct ast_node;
 
-/* A command line may contain multiple pipelines. */
+/* A command line may contain multiple pipelines, combined by control
+ * flow ('&&', '||', if, while, until and for) into a list of statements.
+ * All of its nodes and words are allocated from its arena and are
+ * released together when the last reference to the line is dropped.
+ * Once parsed, a line is not changed.
+ */
 struct ast_command_line {
     struct list/* <ast_pipeline> */ pipes;        /* List of pipelines */
+    struct list/* <ast_node> */ *stmts;          /* What to run */
+    struct obstack arena;    /* Holds everything this line points to */
+    int refcount;            /* The parser's reference, plus one per job */
+    struct ast_command_line *words_from;  /* If a copy of parts of another
+                                             line, the line holding its
+                                             words, else NULL */
+};
+
+/* A statement of a command line */
+enum ast_node_kind {
+    AST_PIPELINE,            /* pipe */
+    AST_AND,                 /* left && right */
+    AST_OR,                  /* left || right */
+    AST_IF,                  /* if cond; then body; else else_part; fi */
+    AST_WHILE,               /* while cond; do body; done */
+    AST_UNTIL,               /* until cond; do body; done */
+    AST_FOR,                 /* for var in words; do body; done */
+};
+
+struct ast_node {
+    enum ast_node_kind kind;
+    struct ast_pipeline *pipe;
+    struct ast_node *left, *right;
+    struct list/* <ast_node> */ *cond;
+    struct list/* <ast_node> */ *body;
+    struct list/* <ast_node> */ *else_part;  /* NULL if there is no else;
+                                                 elif is a nested if */
+    char *var;
+    char **words;            /* NULL terminated */
+    struct list_elem elem;   /* Link element in its list of statements. */
 };
 
 /* A pipeline is a list of one or more commands. 
@@ -24,6 +61,8 @@ struct ast_pipeline {
                                 file 'iored_output' */
     bool append_to_output;   /* True if user typed >> to append */
     bool bg_job;             /* True if user entered & */
+    bool quoted_input;       /* True if the file names were quoted, */
+    bool quoted_output;      /* and so are not expanded */
     struct list_elem elem;   /* Link element. */
 };
 
@@ -31,39 +70,86 @@ struct ast_pipeline {
 struct ast_command {
     char **argv;             /* NULL terminated array of pointers to words
                                 making up this command. */
+    bool *quoted;            /* NULL, or for each word whether it was
+                                quoted, and so is not expanded */
     bool dup_stderr_to_stdout; /* True if stderr should be redirected as well */
     struct list_elem elem;   /* Link element to link commands in pipeline. */
 };
 
 /* Create new command structure and initialize it */
-struct ast_command * ast_command_create(char ** argv,
+struct ast_command * ast_command_create(struct ast_command_line *line,
+                                        char ** argv,
                                         bool dup_stderr_to_stdout);
 
-/* Create a new pipeline containing only one command */
-struct ast_pipeline * ast_pipeline_create(char *iored_input, 
+/* Create a new, empty pipeline */
+struct ast_pipeline * ast_pipeline_create(struct ast_command_line *line,
+                                          char *iored_input, 
                                           char *iored_output, 
                                           bool append_to_output);
 
 /* Add a new command to this pipeline */
 void ast_pipeline_add_command(struct ast_pipeline *pipe, struct ast_command *cmd);
 
-/* Create an empty command line */
-struct ast_command_line * ast_command_line_create_empty(void);
+/* Copy a pipeline into 'line', e.g. to remove words from an argv[]
+ * array of the copy.  The words are shared; 'line' must hold a
+ * reference to the line they come from in words_from. */
+struct ast_pipeline * ast_pipeline_copy(struct ast_command_line *line,
+                                        struct ast_pipeline *pipe);
+
+/* Return true if an unquoted word of the pipeline refers to a
+ * variable, as in $NAME, ${NAME} or $? */
+bool ast_pipeline_has_vars(struct ast_pipeline *pipe);
+
+/* Like ast_pipeline_copy, but replace every reference to a variable by
+ * lookup(name), or by nothing if lookup returns NULL. */
+struct ast_pipeline * ast_pipeline_expand(struct ast_command_line *line,
+                                          struct ast_pipeline *pipe,
+                                          const char *(*lookup)(const char *name));
+
+/* Create a statement of the given kind; set its fields afterwards */
+struct ast_node * ast_node_create(struct ast_command_line *line, enum ast_node_kind kind);
 
-/* Create a command line with a single pipeline */
-struct ast_command_line * ast_command_line_create(struct ast_pipeline *pipe);
+/* Create an empty list of statements */
+struct list * ast_stmts_create(struct ast_command_line *line);
 
-/* Deallocation functions */
+/* Create an empty command line with a fresh arena */
+struct ast_command_line * ast_command_line_create(void);
+
+/* Add a pipeline to the end of this command line */
+void ast_command_line_add_pipeline(struct ast_command_line *line, struct ast_pipeline *pipe);
+
+/* Take another reference to a command line, e.g. for a job that runs
+ * one of its pipelines and may outlive the line. */
+struct ast_command_line * ast_command_line_ref(struct ast_command_line *line);
+
+/* Drop a reference; the last one releases the line's arena and with it
+ * every pipeline, command and word of the line. */
 void ast_command_line_free(struct ast_command_line *);
-void ast_pipeline_free(struct ast_pipeline *);
-void ast_command_free(struct ast_command *);
 
 /* Print functions */
 void ast_command_print(struct ast_command *cmd);
 void ast_pipeline_print(struct ast_pipeline *pipe);
 void ast_command_line_print(struct ast_command_line *line);
 
-/* Parse a command line.  Implemented in shell-grammar.y */
+/* A parser with its own scanner.  A parser handles one line at a time,
+ * but different parsers may be used concurrently.
+ * Implemented in shell-grammar.y */
+struct ast_parser;
+
+struct ast_parser * ast_parser_create(void);
+void ast_parser_destroy(struct ast_parser *parser);
+
+/* Parse the 'len' characters at 'line'.  Returns NULL after printing
+ * why if the line is malformed. */
+struct ast_command_line * ast_parser_parse(struct ast_parser *parser,
+                                           const char *line, size_t len);
+
+/* After ast_parser_parse returned NULL, return true if that was only
+ * because the line ended inside an if, while, until or for, or after
+ * '&&' or '||'; the line may continue on the next one. */
+bool ast_parser_incomplete(struct ast_parser *parser);
+
+/* Parse a command line with a parser kept for the purpose */
 struct ast_command_line * ast_parse_command_line(char * line);
 
 /** ----------------------------------------------------------- */
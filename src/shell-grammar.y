@@ -9,15 +9,27 @@
  * This is based on an assignment as an undergraduate in 1993 
  * as an undergraduate student at Technische Universitaet Berlin.
  *
- * Known bugs: leaks memory when parse errors occur.
+ * Everything the parser builds, including the words returned by the
+ * lexer, is allocated from the arena of the command line being parsed.
+ * Releasing that arena frees the whole line, also after a parse error.
+ *
+ * The parser is pure and the scanner reentrant: all their state lives
+ * in a struct ast_parser, and the scanner reads the whole line from
+ * one buffer.  Separate parsers can parse lines concurrently.
+ *
+ * Pipelines are combined into statements by '&&', '||', if, while,
+ * until and for.  The keywords are ordinary words to the scanner;
+ * yylex() below turns them into keyword tokens where a command may
+ * start, as sh does, so that 'echo done' still prints "done".  Quoted
+ * words (QWORD) are never keywords, and their variables are not
+ * expanded.
  */
 %{
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #define YYDEBUG	1
 int yydebug;
-void yyerror(const char *msg);
-int yylex(void);
 
 /*
  * Error messages, csh-style
@@ -26,6 +38,7 @@ int yylex(void);
 #define INVNUL  "Invalid null command."
 #define AMBINP  "Ambiguous input redirect."
 #define AMBOUT  "Ambiguous output redirect."
+#define BGCOMP  "Background compound commands are not supported."
 
 #include "shell-ast.h"
 #include <obstack.h>
@@ -34,10 +47,60 @@ int yylex(void);
 #define obstack_chunk_alloc malloc
 #define obstack_chunk_free free
 
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+struct ast_parser {
+    yyscan_t scanner;
+    struct ast_command_line *line;  /* The line being parsed; owns the arena */
+
+    /* An obstack of char * to collect argv.  Only the command the parser
+     * is working on grows it; the words move to the arena when the
+     * command is added to its pipeline.  Reused for every line. */
+    struct obstack words;
+    struct obstack quoting;     /* a bool for each word, true if quoted */
+
+    /* What yylex() needs to tell keywords from other words */
+    bool command_start;     /* the next word is in command position */
+    enum { FOR_NONE, FOR_NAME, FOR_IN } for_state;
+    int depth;              /* of unfinished if, while, until and for */
+    int last_token;         /* other than '\n' */
+    bool at_eof;            /* the scanner reached the end of the line */
+    bool reported;          /* an error message was printed */
+};
+
+#define arena_alloc(parser, size) obstack_alloc(&(parser)->line->arena, (size))
+
+/* Copy a word of 'len' characters from the input into the arena */
+static char *
+copy_word(struct ast_parser *parser, const char *word, size_t len)
+{
+    return obstack_copy0(&parser->line->arena, word, len);
+}
+
+/* A word and whether it was quoted */
+struct arg {
+    char *word;
+    bool quoted;
+};
+
+static void
+add_word(struct ast_parser *parser, struct arg arg)
+{
+    obstack_ptr_grow(&parser->words, arg.word);
+    obstack_grow(&parser->quoting, &arg.quoted, sizeof arg.quoted);
+}
+
 struct cmd_helper {
-    struct obstack words;   /* an obstack of char * to collect argv */
+    char **argv;            /* NULL until added to a pipeline */
+    bool *quoted;           /* see struct ast_command */
+    size_t nwords;          /* words collected so far */
     char *iored_input;
     char *iored_output;
+    bool quoted_input;
+    bool quoted_output;
     bool append_to_output;
     bool redirect_stderr;
     struct list_elem elem;
@@ -48,57 +111,52 @@ struct pipe_helper {
 };
 
 static struct pipe_helper *
-init_pipe()
+init_pipe(struct ast_parser *parser)
 {
-    struct pipe_helper * pipe = calloc(1, sizeof *pipe);
+    struct pipe_helper * pipe = arena_alloc(parser, sizeof *pipe);
     list_init(&pipe->commands);
     return pipe;
 }
 
 /* Initialize cmd_helper and, optionally, set first argv */
 static struct cmd_helper *
-init_cmd(char *firstcmd, 
-         char *iored_input, char *iored_output, 
+init_cmd(struct ast_parser *parser, struct arg *firstcmd, 
+         struct arg *iored_input, struct arg *iored_output, 
          bool append_to_output, bool include_stderr)
 {
-    struct cmd_helper * cmd = malloc(sizeof *cmd);
-    obstack_init(&cmd->words);
-    if (firstcmd)
-        obstack_ptr_grow(&cmd->words, firstcmd);
+    struct cmd_helper * cmd = arena_alloc(parser, sizeof *cmd);
+    cmd->argv = NULL;
+    cmd->quoted = NULL;
+    cmd->nwords = 0;
+    if (firstcmd) {
+        add_word(parser, *firstcmd);
+        cmd->nwords++;
+    }
 
-    cmd->iored_output = iored_output;
-    cmd->iored_input = iored_input;
+    cmd->iored_output = iored_output ? iored_output->word : NULL;
+    cmd->iored_input = iored_input ? iored_input->word : NULL;
+    cmd->quoted_output = iored_output && iored_output->quoted;
+    cmd->quoted_input = iored_input && iored_input->quoted;
     cmd->append_to_output = append_to_output;
     cmd->redirect_stderr = include_stderr;
     return cmd;
 }
 
 /* print error message */
-static void p_error(char *msg);
+static void p_error(struct ast_parser *parser, char *msg);
 
-/* Convert cmd_helper to ast_command.
- * Ensures NULL-terminated argv[] array
- */
+/* Convert cmd_helper to ast_command */
 static struct ast_command * 
-make_ast_command(struct cmd_helper *cmd)
+make_ast_command(struct ast_parser *parser, struct cmd_helper *cmd)
 {
-    obstack_ptr_grow(&cmd->words, NULL);
-
-    int sz = obstack_object_size(&cmd->words);
-    char **argv = malloc(sz);
-    memcpy(argv, obstack_finish(&cmd->words), sz);
-    obstack_free(&cmd->words, NULL);
-
-    if (*argv == NULL) {
-        free(argv);
-        return NULL; 
-    }
-
-    return ast_command_create(argv, cmd->redirect_stderr);
+    struct ast_command *command = ast_command_create(parser->line, cmd->argv, cmd->redirect_stderr);
+    command->quoted = cmd->quoted;
+    return command;
 }
 
 static bool
-add_to_pipeline(struct pipe_helper *pipe,
+add_to_pipeline(struct ast_parser *parser,
+                struct pipe_helper *pipe,
                 struct cmd_helper *cmd,
                 bool redirect_stderr)
 {
@@ -107,79 +165,184 @@ add_to_pipeline(struct pipe_helper *pipe,
         last = list_entry(list_back(&pipe->commands), 
                           struct cmd_helper, elem);
         /* Error: 'ls >x | wc' */
-        if (last->iored_output) { p_error(AMBOUT); return false; }
+        if (last->iored_output) { p_error(parser, AMBOUT); return false; }
         last->redirect_stderr = redirect_stderr;
 
         /* Error: 'ls | <x wc' */
-        if (cmd->iored_input) { p_error(AMBINP); return false; }
+        if (cmd->iored_input) { p_error(parser, AMBINP); return false; }
     }
 
-    int sz = obstack_object_size(&cmd->words);
-    if (sz == 0) { p_error(INVNUL); return false; }
+    if (cmd->nwords == 0) { p_error(parser, INVNUL); return false; }
+
+    /* Move the words to a NULL-terminated argv[] array in the arena */
+    obstack_ptr_grow(&parser->words, NULL);
+    size_t sz = obstack_object_size(&parser->words);
+    char **argv = obstack_finish(&parser->words);
+    cmd->argv = memcpy(arena_alloc(parser, sz), argv, sz);
+    obstack_free(&parser->words, argv);
+
+    /* Only commands with quoted words need to say which */
+    sz = obstack_object_size(&parser->quoting);
+    bool *quoted = obstack_finish(&parser->quoting);
+    if (memchr(quoted, true, sz) != NULL)
+        cmd->quoted = memcpy(arena_alloc(parser, sz), quoted, sz);
+    obstack_free(&parser->quoting, quoted);
 
     list_push_back(&pipe->commands, &cmd->elem);
     return true;
 }
 
-/* Called by parser when command line is complete */
-static void cmdline_complete(struct ast_command_line *);
+static struct ast_node *
+make_node(struct ast_parser *parser, enum ast_node_kind kind,
+          struct ast_node *left, struct ast_node *right)
+{
+    struct ast_node *node = ast_node_create(parser->line, kind);
+    node->left = left;
+    node->right = right;
+    return node;
+}
 
-/* work-around for bug in flex 2.31 and later */
-static void yyunput (int c,char *buf_ptr  ) __attribute__((unused));
+/* Make the last statement of 'stmts', which ends in '&', a background job */
+static bool
+set_background(struct ast_parser *parser, struct list *stmts)
+{
+    if (list_empty(stmts))
+        return true;
+
+    struct ast_node *last = list_entry(list_back(stmts), struct ast_node, elem);
+    if (last->kind != AST_PIPELINE) { p_error(parser, BGCOMP); return false; }
+    last->pipe->bg_job = true;
+    return true;
+}
 
 %}
 
+%define api.pure full
+%parse-param {struct ast_parser *parser}
+%lex-param {struct ast_parser *parser}
+
 /* LALR stack types */
 %union {
   struct cmd_helper *command;
   struct pipe_helper *pipe;
   struct ast_pipeline *ast_pipe;
-  struct ast_command_line *cmdline;
+  struct ast_node *node;
+  struct list *stmts;
+  struct arg arg;
   char *word;
 }
 
+%code {
+static int yylex(YYSTYPE *lval, struct ast_parser *parser);
+static void yyerror(struct ast_parser *parser, const char *msg);
+}
+
 /* Nonterminals */
 %type <command> input output
 %type <command> command
 %type <pipe> pipeline
 %type <ast_pipe> ast_pipeline
-%type <cmdline> cmd_list
+%type <stmts> stmt_list closed_list open_list else_part
+%type <node> and_or statement compound for_head
+%type <arg> arg
 
 /* Terminals */
-%token <word> WORD
+%token <word> WORD QWORD
 %token GREATER_GREATER GREATER_AMPERSAND PIPE_AMPERSAND
+%token AND_AND OR_OR
+%token IF THEN ELIF ELSE FI WHILE UNTIL DO DONE FOR IN
 
 %%
-cmd_line: cmd_list { cmdline_complete($1); }
-
-cmd_list:	/* Null Command */ { $$ = ast_command_line_create_empty(); }
-|		ast_pipeline { 
-            $$ = ast_command_line_create($1);
-        } 
-|		cmd_list ';'
-|		cmd_list '&' {
-            $$ = $1;
-            if (!list_empty(&$1->pipes)) {
-                struct ast_pipeline * last;
-                last = list_entry(list_back(&$1->pipes),
-                                  struct ast_pipeline, elem);
-                last->bg_job = true;
-            }
+cmd_line: stmt_list { parser->line->stmts = $1; }
+
+/* A list of statements, separated by ';', '&' or newlines.  A list
+ * is closed if it is empty or ends in a separator, and only a closed
+ * list can be followed by another statement. */
+stmt_list: closed_list
+|		open_list
+
+closed_list: /* Null Command */ { $$ = ast_stmts_create(parser->line); }
+|		closed_list separator
+|		open_list separator
+|		closed_list '&'
+|		open_list '&' {
+            if (!set_background(parser, $1))
+                YYABORT;
         }
-|		cmd_list ';' ast_pipeline	{ 
+
+open_list: closed_list and_or {
             $$ = $1;
-            list_push_back(&$$->pipes, &$3->elem);
+            list_push_back($$, &$2->elem);
         }
-|		cmd_list '&' ast_pipeline	{ 
-            if (!list_empty(&$1->pipes)) {
-                struct ast_pipeline * last;
-                last = list_entry(list_back(&$1->pipes),
-                                  struct ast_pipeline, elem);
-                last->bg_job = true;
-            }
 
+separator: ';'
+|		'\n'
+
+linebreak: /* empty */
+|		linebreak '\n'
+
+and_or:	statement
+|		and_or AND_AND linebreak statement {
+            $$ = make_node(parser, AST_AND, $1, $4);
+        }
+|		and_or OR_OR linebreak statement {
+            $$ = make_node(parser, AST_OR, $1, $4);
+        }
+
+statement: ast_pipeline {
+            $$ = make_node(parser, AST_PIPELINE, NULL, NULL);
+            $$->pipe = $1;
+            ast_command_line_add_pipeline(parser->line, $1);
+        }
+|		compound
+
+compound: IF stmt_list THEN stmt_list else_part FI {
+            $$ = make_node(parser, AST_IF, NULL, NULL);
+            $$->cond = $2;
+            $$->body = $4;
+            $$->else_part = $5;
+        }
+|		WHILE stmt_list DO stmt_list DONE {
+            $$ = make_node(parser, AST_WHILE, NULL, NULL);
+            $$->cond = $2;
+            $$->body = $4;
+        }
+|		UNTIL stmt_list DO stmt_list DONE {
+            $$ = make_node(parser, AST_UNTIL, NULL, NULL);
+            $$->cond = $2;
+            $$->body = $4;
+        }
+|		for_head DO stmt_list DONE {
             $$ = $1;
-            list_push_back(&$$->pipes, &$3->elem);
+            $$->body = $3;
+        }
+
+else_part: /* empty */ { $$ = NULL; }
+|		ELSE stmt_list { $$ = $2; }
+|		ELIF stmt_list THEN stmt_list else_part {
+            struct ast_node * elif = make_node(parser, AST_IF, NULL, NULL);
+            elif->cond = $2;
+            elif->body = $4;
+            elif->else_part = $5;
+            $$ = ast_stmts_create(parser->line);
+            list_push_back($$, &elif->elem);
+        }
+
+/* The words are collected like those of a command, before the body
+ * starts a command of its own */
+for_head: FOR WORD IN for_words separator linebreak {
+            $$ = make_node(parser, AST_FOR, NULL, NULL);
+            $$->var = $2;
+            obstack_ptr_grow(&parser->words, NULL);
+            size_t sz = obstack_object_size(&parser->words);
+            char **words = obstack_finish(&parser->words);
+            $$->words = memcpy(arena_alloc(parser, sz), words, sz);
+            obstack_free(&parser->words, words);
+        }
+
+for_words: /* empty */
+|		for_words arg {
+            obstack_ptr_grow(&parser->words, $2.word);
         }
 
 ast_pipeline: pipeline {
@@ -191,111 +354,249 @@ ast_pipeline: pipeline {
             last = list_entry(list_back(&pipe->commands), struct cmd_helper, elem);
 
             $$ = ast_pipeline_create(
+                parser->line,
                 first->iored_input,
                 last->iored_output,
                 last->append_to_output
             );
+            $$->quoted_input = first->quoted_input;
+            $$->quoted_output = last->quoted_output;
             for (struct list_elem * e = list_begin(&pipe->commands);
                                     e != list_end(&pipe->commands);) {
                 struct cmd_helper * cmd = list_entry(e, struct cmd_helper, elem);
-                ast_pipeline_add_command($$, make_ast_command(cmd));
-                e = list_remove(e);
-                free(cmd);
+                e = list_next(e);
+                ast_pipeline_add_command($$, make_ast_command(parser, cmd));
             }
-            free(pipe);
         }
 
 pipeline: command {
-            $$ = init_pipe();
-            if (!add_to_pipeline($$, $1, false))
+            $$ = init_pipe(parser);
+            if (!add_to_pipeline(parser, $$, $1, false))
                 YYABORT;
 		}
 |		pipeline '|' command {
-            if (!add_to_pipeline($1, $3, false))
+            if (!add_to_pipeline(parser, $1, $3, false))
                 YYABORT;
             $$ = $1;
 		}
 |		pipeline PIPE_AMPERSAND command {
-            if (!add_to_pipeline($1, $3, true))
+            if (!add_to_pipeline(parser, $1, $3, true))
                 YYABORT;
             $$ = $1;
 		}
-|		'|' error 	   { p_error(INVNUL); YYABORT; }
-|		pipeline '|' error { p_error(INVNUL); YYABORT; }
+|		'|' error 	   { p_error(parser, INVNUL); YYABORT; }
+|		pipeline '|' error { p_error(parser, INVNUL); YYABORT; }
+
+arg:	WORD { $$.word = $1; $$.quoted = false; }
+|		QWORD { $$.word = $1; $$.quoted = true; }
 
-command:   WORD { 
-            $$ = init_cmd($1, NULL, NULL, false, false);
+command:   arg { 
+            $$ = init_cmd(parser, &$1, NULL, NULL, false, false);
         }
 |		input   
 |		output
-|		command WORD {
+|		command arg {
             $$ = $1;
-            obstack_ptr_grow(&$$->words, $2);
+            add_word(parser, $2);
+            $$->nwords++;
 		}
 |		command input {
-            obstack_free(&$2->words, NULL);
             /* Error: ambiguous redirect 'a <b <c' */
-            if ($1->iored_input)   { p_error(AMBINP); YYABORT; }
+            if ($1->iored_input)   { p_error(parser, AMBINP); YYABORT; }
             $$ = $1; 
             $$->iored_input = $2->iored_input;
-            free($2);
+            $$->quoted_input = $2->quoted_input;
 		}
 |		command output {
-            obstack_free(&$2->words, NULL);
             /* Error: ambiguous redirect 'a >b >c' */
-            if ($1->iored_output) { p_error(AMBOUT); YYABORT; }
+            if ($1->iored_output) { p_error(parser, AMBOUT); YYABORT; }
             $$ = $1; 
             $$->iored_output = $2->iored_output;
+            $$->quoted_output = $2->quoted_output;
             $$->append_to_output = $2->append_to_output;
             $$->redirect_stderr = $2->redirect_stderr;
-            free($2);
 		}
 
-input:	'<' WORD { 
-            $$ = init_cmd(NULL, $2, NULL, false, false);
+input:	'<' arg { 
+            $$ = init_cmd(parser, NULL, &$2, NULL, false, false);
         }
-|		'<' error	  { p_error(MISRED); YYABORT; }
+|		'<' error	  { p_error(parser, MISRED); YYABORT; }
 
-output:	'>' WORD { 
-            $$ = init_cmd(NULL, NULL, $2, false, false);
+output:	'>' arg { 
+            $$ = init_cmd(parser, NULL, NULL, &$2, false, false);
         }
-|		GREATER_AMPERSAND WORD { 
-            $$ = init_cmd(NULL, NULL, $2, false, true);
+|		GREATER_AMPERSAND arg { 
+            $$ = init_cmd(parser, NULL, NULL, &$2, false, true);
         }
-|		GREATER_GREATER WORD { 
-            $$ = init_cmd(NULL, NULL, $2, true, false);
+|		GREATER_GREATER arg { 
+            $$ = init_cmd(parser, NULL, NULL, &$2, true, false);
         }
 		/* Error: missing redirect */
-|		'>' error 	  { p_error(MISRED); YYABORT; }
-|		GREATER_GREATER error { p_error(MISRED); YYABORT; }
+|		'>' error 	  { p_error(parser, MISRED); YYABORT; }
+|		GREATER_GREATER error { p_error(parser, MISRED); YYABORT; }
 
 %%
-static char * inputline;    /* currently processed input line */
-#define YY_INPUT(buf,result,max_size) \
-    { \
-        result = *inputline ? (buf[0] = *inputline++, 1) : YY_NULL; \
+#define YY_DECL static int scan_token(YYSTYPE *yylval_param, yyscan_t yyscanner)
+#include "lex.yy.c"
+
+static const struct {
+    const char *word;
+    int token;
+} keywords[] = {
+    { "if", IF }, { "then", THEN }, { "elif", ELIF }, { "else", ELSE },
+    { "fi", FI }, { "while", WHILE }, { "until", UNTIL }, { "do", DO },
+    { "done", DONE }, { "for", FOR },
+};
+
+/* Return the token for an unquoted word: a keyword if it is one and
+ * stands where a command may start, else WORD */
+static int
+classify_word(struct ast_parser *parser, const char *word)
+{
+    switch (parser->for_state) {
+    case FOR_NAME:
+        parser->for_state = FOR_IN;
+        return WORD;
+    case FOR_IN:
+        parser->for_state = FOR_NONE;
+        return strcmp(word, "in") == 0 ? IN : WORD;
+    case FOR_NONE:
+        break;
     }
 
-#define YY_NO_INPUT
-#include "lex.yy.c"
+    if (parser->command_start)
+        for (size_t i = 0; i < sizeof keywords / sizeof keywords[0]; i++)
+            if (strcmp(word, keywords[i].word) == 0)
+                return keywords[i].token;
+    return WORD;
+}
+
+static int
+yylex(YYSTYPE *lval, struct ast_parser *parser)
+{
+    int token = scan_token(lval, parser->scanner);
+    if (token == WORD)
+        token = classify_word(parser, lval->word);
+    else if (token == QWORD)
+        parser->for_state = FOR_NONE;
+
+    switch (token) {
+    case IF: case WHILE: case UNTIL:
+        parser->depth++;
+        break;
+    case FOR:
+        parser->depth++;
+        parser->for_state = FOR_NAME;
+        break;
+    case FI: case DONE:
+        parser->depth--;
+        break;
+    case 0:
+        parser->at_eof = true;
+        break;
+    }
+
+    switch (token) {
+    case ';': case '\n': case '&': case '|': case PIPE_AMPERSAND:
+    case AND_AND: case OR_OR:
+    case IF: case THEN: case ELIF: case ELSE: case WHILE: case UNTIL: case DO:
+        parser->command_start = true;
+        break;
+    default:
+        parser->command_start = false;
+        break;
+    }
+
+    if (token != 0 && token != '\n')
+        parser->last_token = token;
+    return token;
+}
 
 static void
-p_error(char *msg) 
+p_error(struct ast_parser *parser, char *msg) 
 { 
     /* print error */
     fprintf(stderr, "%s\n", msg); 
+    parser->reported = true;
 }
 
-extern int yyparse (void);
-
 /* do not use default error handling since errors are handled above. */
-void 
-yyerror(const char *msg) { }
+static void 
+yyerror(struct ast_parser *parser, const char *msg) { }
 
-static struct ast_command_line * commandline;
-static void cmdline_complete(struct ast_command_line *cline)
+/* Create a parser with its own scanner */
+struct ast_parser *
+ast_parser_create(void)
 {
-    commandline = cline;
+    struct ast_parser *parser = malloc(sizeof *parser);
+    if (parser == NULL)
+        return NULL;
+
+    if (yylex_init_extra(parser, &parser->scanner) != 0) {
+        free(parser);
+        return NULL;
+    }
+    obstack_init(&parser->words);
+    obstack_init(&parser->quoting);
+    parser->line = NULL;
+    return parser;
+}
+
+void
+ast_parser_destroy(struct ast_parser *parser)
+{
+    yylex_destroy(parser->scanner);
+    obstack_free(&parser->words, NULL);
+    obstack_free(&parser->quoting, NULL);
+    free(parser);
+}
+
+/* 
+ * parse the 'len' characters at 'line', which need not be NUL-terminated.
+ */
+struct ast_command_line *
+ast_parser_parse(struct ast_parser *parser, const char * line, size_t len)
+{
+    parser->line = ast_command_line_create();
+    parser->command_start = true;
+    parser->for_state = FOR_NONE;
+    parser->depth = 0;
+    parser->last_token = 0;
+    parser->at_eof = false;
+    parser->reported = false;
+
+    /* The scanner works in place on a copy of the line that ends in
+     * the two NULs flex expects. */
+    char *buf = arena_alloc(parser, len + 2);
+    memcpy(buf, line, len);
+    buf[len] = buf[len + 1] = '\0';
+    YY_BUFFER_STATE input = yy_scan_buffer(buf, len + 2, parser->scanner);
+
+    int error = yyparse(parser);
+
+    yy_delete_buffer(input, parser->scanner);
+
+    /* Drop the words of a command left unfinished by an error */
+    obstack_free(&parser->words, obstack_finish(&parser->words));
+    obstack_free(&parser->quoting, obstack_finish(&parser->quoting));
+
+    struct ast_command_line *cline = parser->line;
+    parser->line = NULL;
+    if (error) {
+        /* Errors the grammar does not catch itself */
+        if (!parser->reported && !ast_parser_incomplete(parser))
+            fprintf(stderr, "Syntax error.\n");
+        ast_command_line_free(cline);
+        return NULL;
+    }
+    return cline;
+}
+
+bool
+ast_parser_incomplete(struct ast_parser *parser)
+{
+    return parser->at_eof && !parser->reported
+        && (parser->depth > 0 || parser->last_token == AND_AND || parser->last_token == OR_OR);
 }
 
 /* 
@@ -304,10 +605,9 @@ static void cmdline_complete(struct ast_command_line *cline)
 struct ast_command_line *
 ast_parse_command_line(char * line)
 {
-    inputline = line;
-    commandline = NULL;
-
-    int error = yyparse();
+    static struct ast_parser *parser;
+    if (parser == NULL && (parser = ast_parser_create()) == NULL)
+        return NULL;
 
-    return error ? NULL : commandline;
+    return ast_parser_parse(parser, line, strlen(line));
 }
@@ -5,12 +5,17 @@
  * Virginia Tech.
  */
 
+#define _GNU_SOURCE 1
 #include <signal.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/signalfd.h>
 
 #include "signal_support.h"
 #include "utils.h"
@@ -82,4 +87,47 @@ signal_set_handler(int sig, sa_sigaction_t handler)
 
     if (sigaction(sig, &sa, NULL) != 0)
         utils_fatal_error("sigaction failed for signal %d", sig);
+
+    /* Let posix_spawn reset just the signals we handle in the child,
+     * instead of calling sigaction for every signal. */
+    posix_spawn_signal_handled_np(sig, 1);
+}
+
+/* Block signal 'sig' and return a non-blocking signalfd that becomes
+ * readable whenever 'sig' is pending.  Since the signal stays blocked,
+ * no handler ever runs; the caller reads the fd at a time of its
+ * choosing instead. */
+int
+signal_open_fd(int sig)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, sig);
+    signal_block(sig);
+    /* No handler runs for 'sig'; recording that still spares
+     * posix_spawn from inspecting every signal in the child. */
+    posix_spawn_signal_handled_np(sig, 0);
+
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1)
+        utils_fatal_error("signalfd failed for signal %d", sig);
+    return fd;
+}
+
+/* Consume all signals queued on a signalfd from signal_open_fd */
+void
+signal_drain_fd(int fd)
+{
+    struct signalfd_siginfo info[16];
+
+    for (;;) {
+        ssize_t n = read(fd, info, sizeof info);
+        if (n > 0)
+            continue;
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1 && errno != EAGAIN)
+            utils_error("reading signalfd %d failed: ", fd);
+        return;
+    }
 }
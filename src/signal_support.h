@@ -19,4 +19,11 @@ bool signal_unblock(int sig);
 /* Install signal handler for signal 'sig' */
 void signal_set_handler(int sig, sa_sigaction_t handler);
 
+/* Block signal 'sig' and return a non-blocking signalfd that becomes
+ * readable whenever 'sig' is pending. */
+int signal_open_fd(int sig);
+
+/* Consume all signals queued on a signalfd from signal_open_fd */
+void signal_drain_fd(int fd);
+
 #endif /* __SIGNAL_SUPPORT_H */
@@ -0,0 +1,108 @@
+/*
+ * slab - pool allocator for the shell's fixed-size bookkeeping objects.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include <assert.h>
+
+#include "slab.h"
+#include "utils.h"
+
+/* Free objects are threaded through their first word. */
+struct free_obj {
+    struct free_obj *next;
+};
+
+/* Header placed at the start of every slab. */
+struct slab {
+    struct slab *next;
+    alignas(max_align_t) char objects[];
+};
+
+/* Initialize a cache of objects of the given size */
+void
+slab_cache_init(struct slab_cache *cache, const char *name,
+                size_t object_size, size_t per_slab)
+{
+    size_t align = alignof(max_align_t);
+    if (object_size < sizeof(struct free_obj))
+        object_size = sizeof(struct free_obj);
+
+    cache->name = name;
+    cache->object_size = (object_size + align - 1) & ~(align - 1);
+    cache->per_slab = per_slab;
+    cache->free_list = NULL;
+    cache->slabs = NULL;
+    cache->nslabs = cache->live = cache->nfree = 0;
+}
+
+/* Release all slabs.  All objects must have been freed. */
+void
+slab_cache_destroy(struct slab_cache *cache)
+{
+    assert(cache->live == 0);
+    for (struct slab *s = cache->slabs, *next; s != NULL; s = next) {
+        next = s->next;
+        free(s);
+    }
+    cache->free_list = NULL;
+    cache->slabs = NULL;
+    cache->nslabs = cache->nfree = 0;
+}
+
+/* Allocate a new slab and put all of its objects on the free list */
+static void
+grow(struct slab_cache *cache)
+{
+    struct slab *s = malloc(sizeof *s + cache->per_slab * cache->object_size);
+    if (s == NULL)
+        utils_fatal_error("cannot allocate slab for %s: ", cache->name);
+
+    s->next = cache->slabs;
+    cache->slabs = s;
+    cache->nslabs++;
+
+    for (size_t i = cache->per_slab; i-- > 0; ) {
+        struct free_obj *obj = (struct free_obj *) (s->objects + i * cache->object_size);
+        obj->next = cache->free_list;
+        cache->free_list = obj;
+    }
+    cache->nfree += cache->per_slab;
+}
+
+/* Allocate an uninitialized object */
+void *
+slab_alloc(struct slab_cache *cache)
+{
+    if (cache->free_list == NULL)
+        grow(cache);
+
+    struct free_obj *obj = cache->free_list;
+    cache->free_list = obj->next;
+    cache->nfree--;
+    cache->live++;
+    return obj;
+}
+
+/* Return an object to the cache it was allocated from */
+void
+slab_free(struct slab_cache *cache, void *ptr)
+{
+    struct free_obj *obj = ptr;
+
+    assert(cache->live > 0);
+    obj->next = cache->free_list;
+    cache->free_list = obj;
+    cache->nfree++;
+    cache->live--;
+}
+
+/* Print the counters of a cache to stdout */
+void
+slab_cache_print(struct slab_cache *cache)
+{
+    printf("%s:\t%zu live, %zu free, %zu slabs (%zu bytes/object, %zu objects/slab)\n",
+           cache->name, cache->live, cache->nfree, cache->nslabs,
+           cache->object_size, cache->per_slab);
+}
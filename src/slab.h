@@ -0,0 +1,43 @@
+#ifndef __SLAB_H
+#define __SLAB_H
+
+#include <stddef.h>
+
+/* A simple slab allocator for fixed-size objects.
+ *
+ * Objects are carved out of slabs holding 'per_slab' objects each.
+ * Freed objects go onto a per-cache free list and are handed out
+ * again before a new slab is allocated, so a cache never holds more
+ * memory than its peak number of live objects required.  Slabs are
+ * released only when the cache is destroyed.
+ *
+ * A cache is not safe to use from a signal handler.
+ */
+struct slab_cache {
+    const char *name;           /* Reported by slab_cache_print */
+    size_t object_size;         /* Size of each object, rounded up */
+    size_t per_slab;            /* Number of objects per slab */
+    void *free_list;            /* Singly-linked list of free objects */
+    void *slabs;                /* Singly-linked list of slabs */
+    size_t nslabs;              /* Number of slabs allocated */
+    size_t live;                /* Number of objects handed out */
+    size_t nfree;               /* Number of objects on free_list */
+};
+
+/* Initialize a cache of objects of the given size */
+void slab_cache_init(struct slab_cache *cache, const char *name,
+                     size_t object_size, size_t per_slab);
+
+/* Release all slabs.  All objects must have been freed. */
+void slab_cache_destroy(struct slab_cache *cache);
+
+/* Allocate an uninitialized object */
+void *slab_alloc(struct slab_cache *cache);
+
+/* Return an object to the cache it was allocated from */
+void slab_free(struct slab_cache *cache, void *obj);
+
+/* Print the counters of a cache to stdout */
+void slab_cache_print(struct slab_cache *cache);
+
+#endif /* __SLAB_H */
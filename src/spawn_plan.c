@@ -0,0 +1,312 @@
+/*
+ * spawn_plan - compile pipelines into reusable spawn plans.
+ *
+ * Running the same pipeline again, e.g. after recalling it from the
+ * history, reuses its file actions, attributes and resolved paths
+ * instead of building them from scratch.
+ */
+#define _GNU_SOURCE 1
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spawn_plan.h"
+#include "utils.h"
+
+/* Flags in the first byte of a key */
+#define KEY_BACKGROUND  0x01
+#define KEY_APPEND      0x02
+#define KEY_INPUT       0x04    /* followed by the input file name */
+#define KEY_OUTPUT      0x08    /* followed by the output file name */
+
+/* Flags in the first byte of each stage */
+#define STAGE_DUP_STDERR 0x01
+#define STAGE_FIRST     0x02    /* first command of the pipeline */
+#define STAGE_LAST      0x04    /* last command of the pipeline */
+
+struct key_buffer {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+static void
+key_append(struct key_buffer *key, const void *data, size_t len)
+{
+    if (key->len + len > key->size) {
+        while (key->len + len > key->size)
+            key->size = key->size ? 2 * key->size : 256;
+        key->data = realloc(key->data, key->size);
+        if (key->data == NULL)
+            utils_fatal_error("cannot allocate spawn plan key: ");
+    }
+    memcpy(key->data + key->len, data, len);
+    key->len += len;
+}
+
+static void
+key_append_byte(struct key_buffer *key, char c)
+{
+    key_append(key, &c, 1);
+}
+
+static void
+key_append_string(struct key_buffer *key, const char *s)
+{
+    key_append(key, s, strlen(s) + 1);
+}
+
+/* Serialize everything that determines how the stages are spawned:
+ * the pipeline's redirections and background flag, then for each
+ * stage its flags, argc and NUL-terminated words.  Returns the number
+ * of argv slots the stages need, counting their NULL terminators. */
+static size_t
+build_key(struct key_buffer *key, struct ast_pipeline *pipeline,
+          struct ast_command **cmds, size_t n)
+{
+    struct ast_command *first = list_entry(list_begin(&pipeline->commands), struct ast_command, elem);
+    struct ast_command *last = list_entry(list_back(&pipeline->commands), struct ast_command, elem);
+
+    key_append_byte(key, (pipeline->bg_job ? KEY_BACKGROUND : 0)
+                         | (pipeline->append_to_output ? KEY_APPEND : 0)
+                         | (pipeline->iored_input ? KEY_INPUT : 0)
+                         | (pipeline->iored_output ? KEY_OUTPUT : 0));
+    if (pipeline->iored_input)
+        key_append_string(key, pipeline->iored_input);
+    if (pipeline->iored_output)
+        key_append_string(key, pipeline->iored_output);
+
+    size_t nargv = 0;
+    for (size_t i = 0; i < n; i++) {
+        struct ast_command *cmd = cmds[i];
+        uint32_t argc = 0;
+        while (cmd->argv[argc] != NULL)
+            argc++;
+
+        key_append_byte(key, (cmd->dup_stderr_to_stdout ? STAGE_DUP_STDERR : 0)
+                             | (cmd == first ? STAGE_FIRST : 0)
+                             | (cmd == last ? STAGE_LAST : 0));
+        key_append(key, &argc, sizeof argc);
+        for (uint32_t j = 0; j < argc; j++)
+            key_append_string(key, cmd->argv[j]);
+        nargv += argc + 1;
+    }
+    return nargv;
+}
+
+/* FNV-1a */
+static uint32_t
+hash_key(const char *key, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char) key[i]) * 16777619u;
+    return h;
+}
+
+/* Fill in a plan from its key.  Returns false if it cannot be run. */
+static bool
+compile(struct spawn_plan *plan, struct path_cache *paths,
+        size_t n, size_t nargv, const sigset_t *child_sigmask, int tty_fd)
+{
+    const char *p = plan->key;
+    char flags = *p++;
+    const char *input = NULL, *output = NULL;
+    if (flags & KEY_INPUT) {
+        input = p;
+        p += strlen(p) + 1;
+    }
+    if (flags & KEY_OUTPUT) {
+        output = p;
+        p += strlen(p) + 1;
+    }
+
+    plan->nstages = n;
+    plan->stages = malloc(n * sizeof *plan->stages);
+    plan->actions = malloc(n * sizeof *plan->actions);
+    plan->paths = malloc(n * sizeof *plan->paths);
+    plan->argv = malloc(nargv * sizeof *plan->argv);
+    plan->stage_attrs = calloc(n, sizeof *plan->stage_attrs);
+    if (plan->stages == NULL || plan->actions == NULL || plan->paths == NULL || plan->argv == NULL
+        || plan->stage_attrs == NULL)
+        utils_fatal_error("cannot allocate spawn plan: ");
+
+    char **argv = plan->argv;
+    for (size_t i = 0; i < n; i++) {
+        char stage_flags = *p++;
+        uint32_t argc;
+        memcpy(&argc, p, sizeof argc);
+        p += sizeof argc;
+
+        plan->stages[i].argv = argv;
+        for (uint32_t j = 0; j < argc; j++) {
+            *argv++ = (char *) p;
+            p += strlen(p) + 1;
+        }
+        *argv++ = NULL;
+
+        // 'nice', 'pin' etc. in front of the command
+        size_t nwords;
+        if (!stage_attr_parse(plan->stages[i].argv, &plan->stage_attrs[i], &nwords, false)) {
+            plan->nstages = i;
+            return false;
+        }
+        plan->stages[i].attr = plan->stage_attrs[i] != NULL ? &plan->stage_attrs[i]->attr : NULL;
+        const char *keyword = plan->stages[i].argv[0];
+        plan->stages[i].argv += nwords;
+        if (plan->stages[i].argv[0] == NULL) {
+            fprintf(stderr, "%s: a command is required\n", keyword);
+            stage_attr_free(plan->stage_attrs[i]);
+            plan->nstages = i;
+            return false;
+        }
+
+        posix_spawn_file_actions_t *fa = &plan->actions[i];
+        posix_spawn_file_actions_init(fa);
+        // The pipeline reads its input file in its first command and
+        // writes its output file in its last one
+        if ((stage_flags & STAGE_FIRST) && input != NULL)
+            posix_spawn_file_actions_addopen(fa, STDIN_FILENO, input, O_RDONLY, 0666);
+        if ((stage_flags & STAGE_LAST) && output != NULL) {
+            int append = (flags & KEY_APPEND) ? O_APPEND : O_TRUNC;
+            posix_spawn_file_actions_addopen(fa, STDOUT_FILENO, output, O_WRONLY | append | O_CREAT, 0644);
+        }
+        // Runs after stdout was connected to the pipe or file
+        if (stage_flags & STAGE_DUP_STDERR)
+            posix_spawn_file_actions_adddup2(fa, STDOUT_FILENO, STDERR_FILENO);
+        // Nothing but stdin, stdout and stderr reaches the child, including
+        // descriptors the shell inherited or opened without O_CLOEXEC
+        posix_spawn_file_actions_addclosefrom_np(fa, STDERR_FILENO + 1);
+        plan->stages[i].file_actions = fa;
+    }
+
+    /* Resolve the commands on PATH.  Entries are only valid for one
+     * generation of the path cache, so start over if it was flushed
+     * while we were at it. */
+    do {
+        plan->generation = path_cache_generation(paths);
+        for (size_t i = 0; i < n; i++) {
+            char *name = plan->stages[i].argv[0];
+            plan->paths[i] = path_cache_lookup_entry(paths, name);
+            plan->stages[i].file = plan->paths[i] != NULL ? plan->paths[i]->path : name;
+        }
+    } while (plan->generation != path_cache_generation(paths));
+
+    posix_spawnattr_init(&plan->attr);
+    posix_spawnattr_setsigmask(&plan->attr, child_sigmask);
+    short spawn_flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_USEVFORK | POSIX_SPAWN_SETSIGMASK;
+    // Foreground jobs get the terminal, if there is one
+    if (!(flags & KEY_BACKGROUND) && tty_fd != -1) {
+        spawn_flags |= POSIX_SPAWN_TCSETPGROUP;
+        posix_spawnattr_tcsetpgrp_np(&plan->attr, tty_fd);
+    }
+    posix_spawnattr_setflags(&plan->attr, spawn_flags);
+    return true;
+}
+
+static void
+free_plan(struct spawn_plan *plan)
+{
+    for (size_t i = 0; i < plan->nstages; i++) {
+        posix_spawn_file_actions_destroy(&plan->actions[i]);
+        stage_attr_free(plan->stage_attrs[i]);
+    }
+    posix_spawnattr_destroy(&plan->attr);
+    free(plan->stages);
+    free(plan->actions);
+    free(plan->paths);
+    free(plan->argv);
+    free(plan->stage_attrs);
+    free(plan->key);
+    free(plan);
+}
+
+/* Initialize an empty cache that keeps at most 'capacity' plans */
+void
+spawn_plan_cache_init(struct spawn_plan_cache *cache, size_t capacity)
+{
+    list_init(&cache->plans);
+    cache->count = 0;
+    cache->capacity = capacity;
+    cache->tty_fd = STDIN_FILENO;
+    cache->hits = cache->misses = 0;
+}
+
+/* Free all plans */
+void
+spawn_plan_cache_destroy(struct spawn_plan_cache *cache)
+{
+    spawn_plan_cache_clear(cache);
+}
+
+/* Free all plans, so that pipelines are compiled anew */
+void
+spawn_plan_cache_clear(struct spawn_plan_cache *cache)
+{
+    while (!list_empty(&cache->plans))
+        free_plan(list_entry(list_pop_front(&cache->plans), struct spawn_plan, elem));
+    cache->count = 0;
+}
+
+/* Return a plan for running the commands 'cmds' of 'pipeline' */
+struct spawn_plan *
+spawn_plan_get(struct spawn_plan_cache *cache, struct path_cache *paths,
+               struct ast_pipeline *pipeline, struct ast_command **cmds, size_t n,
+               const sigset_t *child_sigmask)
+{
+    struct key_buffer key = { NULL, 0, 0 };
+    size_t nargv = build_key(&key, pipeline, cmds, n);
+    uint32_t hash = hash_key(key.data, key.len);
+    unsigned long generation = path_cache_generation(paths);
+
+    for (struct list_elem *e = list_begin(&cache->plans); e != list_end(&cache->plans); e = list_next(e)) {
+        struct spawn_plan *plan = list_entry(e, struct spawn_plan, elem);
+        if (plan->hash != hash || plan->keylen != key.len || memcmp(plan->key, key.data, key.len) != 0)
+            continue;
+
+        list_remove(e);
+        if (plan->generation != generation) {
+            // A command may live somewhere else now
+            free_plan(plan);
+            cache->count--;
+            break;
+        }
+        list_push_front(&cache->plans, e);
+        cache->hits++;
+        for (size_t i = 0; i < n; i++)
+            if (plan->paths[i] != NULL)
+                path_cache_reuse(paths, plan->paths[i]);
+        free(key.data);
+        return plan;
+    }
+
+    cache->misses++;
+    struct spawn_plan *plan = calloc(1, sizeof *plan);
+    if (plan == NULL)
+        utils_fatal_error("cannot allocate spawn plan: ");
+    plan->key = key.data;
+    plan->keylen = key.len;
+    plan->hash = hash;
+    if (!compile(plan, paths, n, nargv, child_sigmask, cache->tty_fd)) {
+        free_plan(plan);
+        return NULL;
+    }
+
+    list_push_front(&cache->plans, &plan->elem);
+    if (++cache->count > cache->capacity) {
+        free_plan(list_entry(list_pop_back(&cache->plans), struct spawn_plan, elem));
+        cache->count--;
+    }
+    return plan;
+}
+
+/* Print a one-line summary of cache statistics */
+void
+spawn_plan_cache_print(struct spawn_plan_cache *cache)
+{
+    printf("spawn plans:\t%zu cached, %lu hits, %lu misses\n",
+           cache->count, cache->hits, cache->misses);
+}
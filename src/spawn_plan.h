@@ -0,0 +1,79 @@
+#ifndef __SPAWN_PLAN_H
+#define __SPAWN_PLAN_H
+
+#include <signal.h>
+#include <spawn.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "shell-ast.h"
+#include "path_cache.h"
+#include "stage_attr.h"
+
+/* Everything needed to spawn a pipeline, worked out once: the resolved
+ * executable, argv and file actions of each stage, and the spawn
+ * attributes.  Only the pipes between the stages are created anew
+ * each time the plan is run (by posix_spawn_pipeline_np).
+ *
+ * A plan does not refer to the ast it was compiled from.  Its argv
+ * strings live in its key, a serialized copy of the pipeline.
+ */
+struct spawn_plan {
+    struct list_elem elem;      /* in spawn_plan_cache.plans */
+    char *key;                  /* the pipeline, see build_key() */
+    size_t keylen;
+    uint32_t hash;              /* of the key */
+    unsigned long generation;   /* of the path cache at compile time */
+
+    size_t nstages;
+    struct posix_spawn_stage *stages;
+    posix_spawn_file_actions_t *actions;
+    struct path_cache_entry **paths;    /* NULL if the child searches PATH */
+    char **argv;                /* argv arrays of all stages, back to back */
+    struct stage_attr **stage_attrs;    /* NULL for stages without 'pin' etc. */
+    posix_spawnattr_t attr;
+};
+
+/* Plans for recently run pipelines, most recently used first */
+struct spawn_plan_cache {
+    struct list plans;
+    size_t count;
+    size_t capacity;
+    int tty_fd;                 /* terminal given to foreground jobs, or -1
+                                   if there is none; set before the first
+                                   plan is compiled */
+
+    /* statistics */
+    unsigned long hits;         /* pipelines run from a cached plan */
+    unsigned long misses;       /* pipelines a plan was compiled for */
+};
+
+/* Initialize an empty cache that keeps at most 'capacity' plans.
+ * Foreground jobs get the terminal on standard input. */
+void spawn_plan_cache_init(struct spawn_plan_cache *cache, size_t capacity);
+
+/* Free all plans */
+void spawn_plan_cache_destroy(struct spawn_plan_cache *cache);
+
+/* Free all plans, so that pipelines are compiled anew */
+void spawn_plan_cache_clear(struct spawn_plan_cache *cache);
+
+/* Return a plan for running the 'n' commands 'cmds' of 'pipeline'
+ * (its commands other than builtins), compiling one unless an equal
+ * pipeline was run before and the commands it used are still where
+ * 'paths' found them.  Children get 'child_sigmask' as signal mask.
+ * The settings of keywords such as 'pin' and 'nice' in front of a
+ * command (see stage_attr.h) become spawn attributes of its stage.
+ * The plan belongs to the cache and stays valid until the next call.
+ * Returns NULL, after reporting why, if a command cannot be run. */
+struct spawn_plan *spawn_plan_get(struct spawn_plan_cache *cache,
+                                  struct path_cache *paths,
+                                  struct ast_pipeline *pipeline,
+                                  struct ast_command **cmds, size_t n,
+                                  const sigset_t *child_sigmask);
+
+/* Print a one-line summary of cache statistics */
+void spawn_plan_cache_print(struct spawn_plan_cache *cache);
+
+#endif /* __SPAWN_PLAN_H */
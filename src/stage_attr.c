@@ -0,0 +1,515 @@
+/*
+ * stage_attr - per-command CPU placement, priorities and resource limits.
+ *
+ * Parses the 'pin', 'nice', 'ionice' and 'ulimit' keywords into spawn
+ * attributes, and runs them as builtins when no command follows.
+ */
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <limits.h>
+#include <linux/ioprio.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "stage_attr.h"
+#include "utils.h"
+
+#define BITS_PER_LONG (CHAR_BIT * sizeof(unsigned long))
+
+/* Largest CPU or node number 'pin' accepts */
+#define PIN_MAX_ID 65535
+
+/* Limits 'ulimit' knows, in the order 'ulimit -a' prints them */
+static const struct rlimit_option {
+    char letter;
+    int resource;
+    rlim_t unit;                /* in bytes, for limits on sizes */
+    const char *description;
+} rlimit_options[] = {
+    { 'c', RLIMIT_CORE,    512,  "core file size (blocks)" },
+    { 'd', RLIMIT_DATA,    1024, "data seg size (kbytes)" },
+    { 'f', RLIMIT_FSIZE,   512,  "file size (blocks)" },
+    { 'l', RLIMIT_MEMLOCK, 1024, "max locked memory (kbytes)" },
+    { 'm', RLIMIT_RSS,     1024, "max memory size (kbytes)" },
+    { 'n', RLIMIT_NOFILE,  1,    "open files" },
+    { 's', RLIMIT_STACK,   1024, "stack size (kbytes)" },
+    { 't', RLIMIT_CPU,     1,    "cpu time (seconds)" },
+    { 'u', RLIMIT_NPROC,   1,    "max user processes" },
+    { 'v', RLIMIT_AS,      1024, "virtual memory (kbytes)" },
+};
+
+#define NRLIMIT_OPTIONS (sizeof rlimit_options / sizeof rlimit_options[0])
+
+static const struct rlimit_option *
+find_rlimit_option(char letter)
+{
+    for (size_t i = 0; i < NRLIMIT_OPTIONS; i++)
+        if (rlimit_options[i].letter == letter)
+            return &rlimit_options[i];
+    return NULL;
+}
+
+static const struct rlimit_option *
+find_rlimit_resource(int resource)
+{
+    for (size_t i = 0; i < NRLIMIT_OPTIONS; i++)
+        if (rlimit_options[i].resource == resource)
+            return &rlimit_options[i];
+    return NULL;
+}
+
+/* Parse a decimal integer between min and max */
+static bool
+parse_int(const char *s, long min, long max, int *value)
+{
+    char *end;
+    errno = 0;
+    long l = strtol(s, &end, 10);
+    if (errno != 0 || end == s || *end != '\0' || l < min || l > max)
+        return false;
+    *value = l;
+    return true;
+}
+
+/* Parse a list such as "0-3,8,10-11" of CPU or node numbers.  Sets the
+ * bits they name in 'mask' unless it is NULL, and stores the highest
+ * number in *max.  Returns false if the list is malformed. */
+static bool
+parse_id_list(const char *s, unsigned long *mask, unsigned long *max)
+{
+    *max = 0;
+    do {
+        char *end;
+        if (*s < '0' || *s > '9')
+            return false;
+        unsigned long lo = strtoul(s, &end, 10), hi = lo;
+        if (*end == '-') {
+            s = end + 1;
+            if (*s < '0' || *s > '9')
+                return false;
+            hi = strtoul(s, &end, 10);
+        }
+        if (lo > hi || hi > PIN_MAX_ID)
+            return false;
+        if (hi > *max)
+            *max = hi;
+        for (unsigned long id = lo; mask != NULL && id <= hi; id++)
+            mask[id / BITS_PER_LONG] |= 1UL << (id % BITS_PER_LONG);
+        s = end;
+    } while (*s++ == ',');
+    return s[-1] == '\0';
+}
+
+/* Allocate a bit mask with the bits in list 's' set, or return NULL
+ * if the list is malformed.  *nlongs is set to its length. */
+static unsigned long *
+id_list_mask(const char *s, size_t *nlongs)
+{
+    unsigned long max;
+    if (!parse_id_list(s, NULL, &max))
+        return NULL;
+    *nlongs = max / BITS_PER_LONG + 1;
+    unsigned long *mask = calloc(*nlongs, sizeof *mask);
+    if (mask == NULL)
+        utils_fatal_error("cannot allocate stage attributes: ");
+    parse_id_list(s, mask, &max);
+    return mask;
+}
+
+/* pin [-m nodes | -i nodes] cpus */
+static char *const *
+parse_pin(struct stage_attr *attr, char *const *argv)
+{
+    char *const *p = argv + 1;
+    if (*p != NULL && (strcmp(*p, "-m") == 0 || strcmp(*p, "-i") == 0)) {
+        int mode = strcmp(*p, "-m") == 0 ? MPOL_BIND : MPOL_INTERLEAVE;
+        size_t nlongs;
+        free(attr->nodes);
+        if (p[1] == NULL || (attr->nodes = id_list_mask(p[1], &nlongs)) == NULL)
+            return NULL;
+        // The kernel only looks at maxnode - 1 bits
+        posix_spawnattr_setmempolicy_np(&attr->attr, mode, attr->nodes,
+                                        nlongs * BITS_PER_LONG + 1);
+        p += 2;
+    }
+
+    size_t nlongs;
+    free(attr->cpus);
+    if (*p == NULL || (attr->cpus = (cpu_set_t *) id_list_mask(*p, &nlongs)) == NULL)
+        return NULL;
+    // cpu_set_t is a bit mask of unsigned longs; CPU_ALLOC_SIZE rounds
+    // up to whole longs as well
+    posix_spawnattr_setaffinity_np(&attr->attr, nlongs * sizeof(unsigned long), attr->cpus);
+    return p + 1;
+}
+
+/* nice [-n adjustment], also written -nadjustment, --adjustment=adjustment
+ * or, first, -adjustment as in nice(1) */
+static char *const *
+parse_nice(struct stage_attr *attr, char *const *argv)
+{
+    char *const *p = argv + 1;
+    int adjustment = 10;
+    // The old form: -5, or --5 for -5
+    const char *digits = *p == NULL || (*p)[0] != '-' ? "" : *p + ((*p)[1] == '-' ? 2 : 1);
+    if (*digits >= '0' && *digits <= '9') {
+        if (!parse_int(*p + 1, INT_MIN, INT_MAX, &adjustment))
+            return argv;
+        p++;
+    }
+    for (; *p != NULL && (*p)[0] == '-'; p++) {
+        const char *value;
+        if (strcmp(*p, "--") == 0) {
+            p++;
+            break;
+        }
+        if (strcmp(*p, "-n") == 0 || strcmp(*p, "--adjustment") == 0)
+            value = *++p;
+        else if (strncmp(*p, "-n", 2) == 0)
+            value = *p + 2;
+        else if (strncmp(*p, "--adjustment=", 13) == 0)
+            value = *p + 13;
+        else
+            return argv;
+        if (value == NULL || !parse_int(value, INT_MIN, INT_MAX, &adjustment))
+            return argv;
+    }
+
+    // Like nice(1), relative to the shell's own nice value
+    if (adjustment < -2 * NZERO)
+        adjustment = -2 * NZERO;
+    if (adjustment > 2 * NZERO)
+        adjustment = 2 * NZERO;
+    int nice = getpriority(PRIO_PROCESS, 0) + adjustment;
+    if (nice < -NZERO)
+        nice = -NZERO;
+    if (nice > NZERO - 1)
+        nice = NZERO - 1;
+    posix_spawnattr_setnice_np(&attr->attr, nice);
+    return p;
+}
+
+static const char *ioprio_class_names[] = {
+    [IOPRIO_CLASS_NONE] = "none",
+    [IOPRIO_CLASS_RT] = "realtime",
+    [IOPRIO_CLASS_BE] = "best-effort",
+    [IOPRIO_CLASS_IDLE] = "idle",
+};
+
+/* Parse an I/O scheduling class, given by number or by name */
+static bool
+parse_ioprio_class(const char *s, int *class)
+{
+    if (parse_int(s, IOPRIO_CLASS_NONE, IOPRIO_CLASS_IDLE, class))
+        return true;
+    for (*class = IOPRIO_CLASS_IDLE; *class >= 0; (*class)--)
+        if (strcasecmp(s, ioprio_class_names[*class]) == 0)
+            return true;
+    return false;
+}
+
+/* ionice [-c class] [-n level], also written -cclass, --class class,
+ * --class=class and likewise for -n and --classdata */
+static char *const *
+parse_ionice(struct stage_attr *attr, char *const *argv)
+{
+    char *const *p = argv + 1;
+    int class = IOPRIO_CLASS_BE, level = 4;
+    for (; *p != NULL && (*p)[0] == '-' && (*p)[1] != '\0'; p++) {
+        const char *opt = *p + 1, *value;
+        char letter;
+        if (strcmp(*p, "--") == 0) {
+            p++;
+            break;
+        }
+        if (*opt == '-') {
+            size_t len = strcspn(++opt, "=");
+            if (len == 5 && strncmp(opt, "class", len) == 0)
+                letter = 'c';
+            else if (len == 9 && strncmp(opt, "classdata", len) == 0)
+                letter = 'n';
+            else
+                return argv;
+            value = opt[len] == '=' ? opt + len + 1 : *++p;
+        } else {
+            letter = *opt;
+            value = opt[1] != '\0' ? opt + 1 : *++p;
+        }
+        // -p, -t etc. are left to ionice(1)
+        if (value == NULL || (letter != 'c' && letter != 'n'))
+            return argv;
+        if (letter == 'n' ? !parse_int(value, 0, 7, &level) : !parse_ioprio_class(value, &class))
+            return argv;
+    }
+
+    // Levels are meaningless for the idle class
+    if (class == IOPRIO_CLASS_IDLE)
+        level = 0;
+    posix_spawnattr_setioprio_np(&attr->attr, IOPRIO_PRIO_VALUE(class, level));
+    return p;
+}
+
+/* Set the limit on 'resource', replacing an earlier one */
+static void
+set_rlimit(struct stage_attr *attr, int resource, const struct rlimit *limit)
+{
+    size_t i = 0;
+    while (i < attr->nrlimits && attr->rlimits[i].resource != resource)
+        i++;
+    attr->rlimits[i].resource = resource;
+    attr->rlimits[i].limit = *limit;
+    if (i == attr->nrlimits)
+        attr->nrlimits++;
+}
+
+static void
+add_query(struct stage_attr *attr, int resource)
+{
+    if (attr->nqueries < RLIM_NLIMITS)
+        attr->queries[attr->nqueries++] = resource;
+}
+
+/* Parse "unlimited" or a number of units into *value */
+static bool
+parse_limit(const char *s, const struct rlimit_option *opt, rlim_t *value)
+{
+    if (strcmp(s, "unlimited") == 0) {
+        *value = RLIM_INFINITY;
+        return true;
+    }
+    if (*s < '0' || *s > '9')
+        return false;
+
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (errno != 0 || *end != '\0' || n > (RLIM_INFINITY - 1) / opt->unit)
+        return false;
+    *value = n * opt->unit;
+    return true;
+}
+
+/* ulimit [-H] [-S] [-a] [-X [limit]]..., where letters may be grouped as
+ * in -Hn; a limit follows the last letter of its word */
+static char *const *
+parse_ulimit(struct stage_attr *attr, char *const *argv)
+{
+    struct {
+        int resource;
+        rlim_t value;
+    } pending[NRLIMIT_OPTIONS];
+    size_t npending = 0;
+    bool hard = false, soft = false;
+
+    char *const *p = argv + 1;
+    for (; *p != NULL && (*p)[0] == '-' && (*p)[1] != '\0'; p++) {
+        for (const char *letter = *p + 1; *letter != '\0'; letter++) {
+            if (*letter == 'H')
+                hard = true;
+            else if (*letter == 'S')
+                soft = true;
+            else if (*letter == 'a') {
+                for (size_t i = 0; i < NRLIMIT_OPTIONS; i++)
+                    add_query(attr, rlimit_options[i].resource);
+            } else {
+                const struct rlimit_option *opt = find_rlimit_option(*letter);
+                if (opt == NULL)
+                    return NULL;
+                rlim_t value;
+                if (letter[1] == '\0' && p[1] != NULL && parse_limit(p[1], opt, &value)) {
+                    size_t i = 0;
+                    while (i < npending && pending[i].resource != opt->resource)
+                        i++;
+                    pending[i].resource = opt->resource;
+                    pending[i].value = value;
+                    if (i == npending)
+                        npending++;
+                    p++;
+                } else {
+                    add_query(attr, opt->resource);
+                }
+            }
+        }
+    }
+
+    // Like bash, 'ulimit' alone reports the file size limit
+    if (p == argv + 1) {
+        if (*p != NULL)
+            return NULL;
+        add_query(attr, RLIMIT_FSIZE);
+    }
+    attr->query_hard = hard && !soft;
+
+    for (size_t i = 0; i < npending; i++) {
+        struct rlimit limit;
+        if (getrlimit(pending[i].resource, &limit) != 0)
+            return NULL;
+        // Without -H or -S, set both limits
+        if (soft || !hard)
+            limit.rlim_cur = pending[i].value;
+        if (hard || !soft)
+            limit.rlim_max = pending[i].value;
+        if (limit.rlim_cur > limit.rlim_max)
+            limit.rlim_cur = limit.rlim_max;
+        set_rlimit(attr, pending[i].resource, &limit);
+    }
+    return p;
+}
+
+/* The parse functions return the word after the keyword's options,
+ * NULL if they are malformed, or 'argv' itself to leave the keyword to
+ * the program of that name, e.g. for 'ionice -p pid' */
+static const struct keyword {
+    const char *name;
+    char *const *(*parse)(struct stage_attr *attr, char *const *argv);
+    const char *usage;
+} keywords[] = {
+    { "pin", parse_pin, "pin [-m nodes | -i nodes] cpus command [args...]" },
+    { "nice", parse_nice, "nice [-n adjustment] command [args...]" },
+    { "ionice", parse_ionice, "ionice [-c class] [-n level] command [args...]" },
+    { "ulimit", parse_ulimit, "ulimit [-HSa] [-cdflmnstuv [limit]]... [command [args...]]" },
+    { NULL, NULL, NULL }
+};
+
+static const struct keyword *
+find_keyword(const char *word)
+{
+    for (const struct keyword *k = keywords; k->name != NULL; k++)
+        if (strcmp(word, k->name) == 0)
+            return k;
+    return NULL;
+}
+
+/* Return true if 'word' is one of the keywords */
+bool
+stage_attr_keyword(const char *word)
+{
+    return find_keyword(word) != NULL;
+}
+
+/* Free settings returned by stage_attr_parse */
+void
+stage_attr_free(struct stage_attr *attr)
+{
+    if (attr == NULL)
+        return;
+    posix_spawnattr_destroy(&attr->attr);
+    free(attr->cpus);
+    free(attr->nodes);
+    free(attr);
+}
+
+/* Parse the keywords and their options at the start of 'argv' */
+bool
+stage_attr_parse(char *const *argv, struct stage_attr **attrp, size_t *nwords, bool quiet)
+{
+    struct stage_attr *attr = NULL;
+    char *const *p = argv;
+    const struct keyword *k;
+    while (*p != NULL && (k = find_keyword(*p)) != NULL) {
+        if (attr == NULL) {
+            attr = calloc(1, sizeof *attr);
+            if (attr == NULL)
+                utils_fatal_error("cannot allocate stage attributes: ");
+            posix_spawnattr_init(&attr->attr);
+        }
+        char *const *next = k->parse(attr, p);
+        if (next == p)
+            break;
+        if (next == NULL) {
+            if (!quiet)
+                fprintf(stderr, "%s: usage: %s\n", k->name, k->usage);
+            stage_attr_free(attr);
+            return false;
+        }
+        p = next;
+    }
+
+    // A keyword left to its program sets nothing
+    if (p == argv) {
+        stage_attr_free(attr);
+        attr = NULL;
+    }
+    if (attr != NULL && attr->nqueries > 0 && *p != NULL) {
+        if (!quiet)
+            fprintf(stderr, "ulimit: limits must be given a value when a command follows\n");
+        stage_attr_free(attr);
+        return false;
+    }
+    if (attr != NULL)
+        posix_spawnattr_setrlimits_np(&attr->attr, attr->rlimits, attr->nrlimits);
+
+    *attrp = attr;
+    *nwords = p - argv;
+    return true;
+}
+
+static void
+print_limit(const struct rlimit_option *opt, rlim_t value, bool describe)
+{
+    if (describe)
+        printf("%-28s(-%c) ", opt->description, opt->letter);
+    if (value == RLIM_INFINITY)
+        printf("unlimited\n");
+    else
+        printf("%llu\n", (unsigned long long) (value / opt->unit));
+}
+
+/* Run a keyword that is not followed by a command as a builtin */
+bool
+stage_attr_builtin(char *const *argv)
+{
+    if (strcmp(argv[0], "nice") == 0 && argv[1] == NULL) {
+        printf("%d\n", getpriority(PRIO_PROCESS, 0));
+        return false;
+    }
+    if (strcmp(argv[0], "ionice") == 0 && argv[1] == NULL) {
+        int ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+        if (ioprio < 0) {
+            perror("ionice");
+            return false;
+        }
+        int class = IOPRIO_PRIO_CLASS(ioprio);
+        if (class > IOPRIO_CLASS_IDLE)
+            printf("unknown: prio %lu\n", IOPRIO_PRIO_DATA(ioprio));
+        else if (class == IOPRIO_CLASS_IDLE)
+            printf("%s\n", ioprio_class_names[class]);
+        else
+            printf("%s: prio %lu\n", ioprio_class_names[class], IOPRIO_PRIO_DATA(ioprio));
+        return false;
+    }
+
+    struct stage_attr *attr;
+    size_t nwords;
+    if (!stage_attr_parse(argv, &attr, &nwords, false))
+        return false;
+    if (strcmp(argv[0], "ulimit") != 0 || argv[nwords] != NULL) {
+        fprintf(stderr, "%s: a command is required\n", argv[0]);
+        stage_attr_free(attr);
+        return false;
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < attr->nrlimits; i++) {
+        const struct rlimit_option *opt = find_rlimit_resource(attr->rlimits[i].resource);
+        if (setrlimit(opt->resource, &attr->rlimits[i].limit) != 0)
+            fprintf(stderr, "ulimit: %s: cannot modify limit: %s\n", opt->description, strerror(errno));
+        else
+            changed = true;
+    }
+    for (size_t i = 0; i < attr->nqueries; i++) {
+        const struct rlimit_option *opt = find_rlimit_resource(attr->queries[i]);
+        struct rlimit limit;
+        if (getrlimit(opt->resource, &limit) != 0)
+            continue;
+        print_limit(opt, attr->query_hard ? limit.rlim_max : limit.rlim_cur, attr->nqueries > 1);
+    }
+    stage_attr_free(attr);
+    return changed;
+}
@@ -0,0 +1,52 @@
+#ifndef __STAGE_ATTR_H
+#define __STAGE_ATTR_H
+
+#include <sched.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+/* Settings for a single command that are given by the keywords
+ * 'pin', 'nice', 'ionice' and 'ulimit' in front of it, as in
+ *
+ *      nice -n 19 ionice -c idle ulimit -v 1000000 make
+ *
+ * The spawn library applies them in the child before it execs the
+ * command, so unlike the programs of the same name they cost no
+ * extra process.  Other commands of the pipeline are not affected.
+ */
+struct stage_attr {
+    posix_spawnattr_t attr;     /* holds only the settings below */
+    cpu_set_t *cpus;            /* NULL unless pinned */
+    unsigned long *nodes;       /* NULL if the memory policy is unchanged */
+    struct posix_spawn_rlimit rlimits[RLIM_NLIMITS];
+    size_t nrlimits;
+
+    /* Limits 'ulimit' was asked to print, i.e. its -X options without a
+     * value.  Only allowed if no command follows. */
+    int queries[RLIM_NLIMITS];
+    size_t nqueries;
+    bool query_hard;            /* print hard rather than soft limits */
+};
+
+/* Return true if 'word' is one of the keywords above */
+bool stage_attr_keyword(const char *word);
+
+/* Parse the keywords and their options at the start of 'argv'.  Stores
+ * the settings in *attrp (NULL if argv does not start with a keyword)
+ * and the number of words they take up in *nwords; the command follows
+ * them.  A keyword given options only its program knows, such as
+ * 'ionice -p pid', is left as the command.  If they are malformed,
+ * prints why unless 'quiet' is set and returns false. */
+bool stage_attr_parse(char *const *argv, struct stage_attr **attrp, size_t *nwords, bool quiet);
+
+/* Free settings returned by stage_attr_parse */
+void stage_attr_free(struct stage_attr *attr);
+
+/* Run a keyword that is not followed by a command as a builtin: 'ulimit'
+ * prints or changes the shell's own limits, 'nice' and 'ionice' print
+ * the shell's priorities.  Returns true if the shell's limits changed. */
+bool stage_attr_builtin(char *const *argv);
+
+#endif /* __STAGE_ATTR_H */
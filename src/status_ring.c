@@ -0,0 +1,105 @@
+/*
+ * status_ring - hand child status changes from the SIGCHLD handler
+ * to the main program without locks.
+ */
+#include <stdio.h>
+#include <assert.h>
+
+#include "status_ring.h"
+
+/* Initialize an empty ring */
+void
+status_ring_init(struct status_ring *ring)
+{
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overflowed, false);
+    atomic_init(&ring->overflows, 0);
+    ring->drained = ring->batches = ring->max_batch = 0;
+    ring->max_delay_ns = 0;
+}
+
+/* Return true if the producer can push another record */
+bool
+status_ring_has_room(struct status_ring *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail < STATUS_RING_SIZE;
+}
+
+/* Append a record.  Only async-signal-safe functions are used. */
+void
+status_ring_push(struct status_ring *ring, pid_t pid, int status,
+                 const struct rusage *usage)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct child_status *rec = &ring->records[head & (STATUS_RING_SIZE - 1)];
+
+    rec->pid = pid;
+    rec->status = status;
+    rec->usage = *usage;
+    clock_gettime(CLOCK_MONOTONIC, &rec->when);
+
+    /* publish the record only after it has been filled in */
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Remember that the producer had to stop because the ring was full */
+void
+status_ring_note_overflow(struct status_ring *ring)
+{
+    atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+    atomic_store_explicit(&ring->overflowed, true, memory_order_release);
+}
+
+/* Return true, and clear the flag, if the producer stopped early */
+bool
+status_ring_take_overflow(struct status_ring *ring)
+{
+    return atomic_exchange_explicit(&ring->overflowed, false, memory_order_acq_rel);
+}
+
+/* Pop up to max records into batch, oldest first */
+size_t
+status_ring_pop(struct status_ring *ring, struct child_status *batch, size_t max)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t n = head - tail;
+
+    assert(n <= STATUS_RING_SIZE);
+    if (n > max)
+        n = max;
+    if (n == 0)
+        return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (size_t i = 0; i < n; i++) {
+        batch[i] = ring->records[(tail + i) & (STATUS_RING_SIZE - 1)];
+        long delay = (now.tv_sec - batch[i].when.tv_sec) * 1000000000L
+                   + (now.tv_nsec - batch[i].when.tv_nsec);
+        if (delay > ring->max_delay_ns)
+            ring->max_delay_ns = delay;
+    }
+
+    /* hand the slots back to the producer */
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+
+    ring->drained += n;
+    ring->batches++;
+    if (n > ring->max_batch)
+        ring->max_batch = n;
+    return n;
+}
+
+/* Print the ring's statistics to stdout */
+void
+status_ring_print(struct status_ring *ring)
+{
+    printf("child events:\t%lu reaped, %lu batches (max %lu), "
+           "%lu overflows, max delay %ld us\n",
+           ring->drained, ring->batches, ring->max_batch,
+           atomic_load(&ring->overflows), ring->max_delay_ns / 1000);
+}
@@ -0,0 +1,68 @@
+#ifndef __STATUS_RING_H
+#define __STATUS_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/* A record of one child status change, as returned by wait4() */
+struct child_status {
+    pid_t pid;
+    int status;
+    struct rusage usage;        /* resources used by the child */
+    struct timespec when;       /* CLOCK_MONOTONIC time it was reaped */
+};
+
+#define STATUS_RING_SIZE 256    /* must be a power of two */
+
+/* A lock-free single-producer, single-consumer ring of child status
+ * changes.
+ *
+ * The producer is the SIGCHLD handler (or the main program while
+ * SIGCHLD is blocked); status_ring_push is async-signal-safe.  The
+ * consumer is the main program, which drains records in batches.
+ * head and tail count records ever pushed and popped; they are never
+ * wrapped, only the index into records[] is.
+ */
+struct status_ring {
+    struct child_status records[STATUS_RING_SIZE];
+    atomic_size_t head;         /* written by the producer only */
+    atomic_size_t tail;         /* written by the consumer only */
+    atomic_bool overflowed;     /* producer found the ring full */
+
+    /* statistics, each written by one side only */
+    atomic_ulong overflows;     /* times the ring was found full */
+    unsigned long drained;      /* records popped */
+    unsigned long batches;      /* non-empty calls to status_ring_pop */
+    unsigned long max_batch;    /* largest number of records popped at once */
+    long max_delay_ns;          /* longest time a record waited in the ring */
+};
+
+/* Initialize an empty ring */
+void status_ring_init(struct status_ring *ring);
+
+/* Return true if the producer can push another record */
+bool status_ring_has_room(struct status_ring *ring);
+
+/* Append a record.  The ring must have room. */
+void status_ring_push(struct status_ring *ring, pid_t pid, int status,
+                      const struct rusage *usage);
+
+/* Remember that the producer had to stop because the ring was full */
+void status_ring_note_overflow(struct status_ring *ring);
+
+/* Return true, and clear the flag, if the producer stopped early
+ * since the last call. */
+bool status_ring_take_overflow(struct status_ring *ring);
+
+/* Pop up to max records into batch, oldest first.
+ * Returns the number of records popped. */
+size_t status_ring_pop(struct status_ring *ring, struct child_status *batch, size_t max);
+
+/* Print the ring's statistics to stdout */
+void status_ring_print(struct status_ring *ring);
+
+#endif /* __STATUS_RING_H */
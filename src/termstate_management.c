@@ -10,6 +10,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -17,7 +18,8 @@
 #include "utils.h"
 #include "signal_support.h"
 
-static int terminal_fd = -1;           /* The controlling terminal */
+static int terminal_fd = -1;           /* The controlling terminal, or -1
+                                          if the shell runs without one */
 static struct termios saved_tty_state; /* The state of the terminal when shell
                                            was started. */
 static int shell_pgrp;          /* The pgrp of the shell when it started */
@@ -40,11 +42,43 @@ termstate_init(void)
     termstate_sample();
 }
 
+/* Initialize tty support for a shell running a script.  Returns false,
+ * and leaves terminal handoff disabled, if the shell has no controlling
+ * terminal or is not in its foreground, e.g. under cron or in CI. */
+bool
+termstate_try_init(void)
+{
+    assert(terminal_fd == -1 || !!!"termstate_init already called");
+
+    shell_pgrp = getpgrp();
+    int fd = open(ctermid(NULL), O_RDWR | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    if (tcgetpgrp(fd) != shell_pgrp) {
+        close(fd);
+        return false;
+    }
+    terminal_fd = fd;
+    termstate_sample();
+    return true;
+}
+
+/* Return true if the shell hands the terminal to its jobs */
+bool
+termstate_has_terminal(void)
+{
+    return terminal_fd != -1;
+}
+
 /* Save current terminal settings.
  * This function is used when a job is suspended.*/
 void 
 termstate_save(struct termios *saved_tty_state)
 {
+    if (terminal_fd == -1)
+        return;
+
     int rc = tcgetattr(terminal_fd, saved_tty_state);
     if (rc == -1)
         utils_fatal_error("tcgetattr failed: ");
@@ -90,6 +124,9 @@ termstate_get_tty_fd(void)
 void
 termstate_give_terminal_to(struct termios *pg_tty_state, pid_t pgrp)
 {
+    if (terminal_fd == -1)
+        return;
+
     signal_block(SIGTTOU);
     int rc = tcsetpgrp(termstate_get_tty_fd(), pgrp);
     if (rc == -1)
@@ -1,11 +1,21 @@
 #ifndef __TERMSTATE_MANAGEMENT_H
 #define __TERMSTATE_MANAGEMENT_H
 
+#include <stdbool.h>
 #include <sys/types.h>
 
 /* Initialize tty support. */
 void termstate_init(void);
 
+/* Initialize tty support if the shell has a controlling terminal and
+ * is in its foreground.  Otherwise, return false; the functions below
+ * that save, restore or hand over the terminal then do nothing.
+ */
+bool termstate_try_init(void);
+
+/* Return true if tty support is initialized */
+bool termstate_has_terminal(void);
+
 /* Save current terminal settings.
  * This function should be called when a job is suspended and the
  * state should be saved for this job so it can be restored with
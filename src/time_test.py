@@ -0,0 +1,43 @@
+#
+# Tests the 'time' prefix
+#
+# Checks that the shell reports the real, user and system time of a
+# timed job once it finishes, and for a pipeline also what each of its
+# stages used.
+#
+import atexit, proc_check, time, os, tempfile
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. A single command
+#
+sendline("time sleep 0.2")
+real, = expect_regex(r"real\t(\d+\.\d{3})s\r\n")
+assert 0.2 <= float(real) < 2, "Expected the real time of sleep 0.2, got %s" % real
+expect(r"user\t\d+\.\d{3}s\r\n", "Expected the user time")
+expect(r"sys\t\d+\.\d{3}s\r\n", "Expected the system time")
+expect_prompt("Shell did not print expected prompt after time")
+
+# Step 2. A pipeline, broken down by stage
+#
+sendline("time sleep 0.1 | cat")
+expect(r"real\t\d+\.\d{3}s\r\n", "Expected the real time of the pipeline")
+expect(r"user\t\d+\.\d{3}s\r\n", "Expected the user time")
+expect(r"sys\t\d+\.\d{3}s\r\n", "Expected the system time")
+expect(r"  sleep +user \d+\.\d{3}s  sys \d+\.\d{3}s  maxrss \d+K", "Expected the usage of sleep")
+expect(r"  cat +user \d+\.\d{3}s  sys \d+\.\d{3}s  maxrss \d+K", "Expected the usage of cat")
+expect_prompt("Shell did not print expected prompt after time")
+
+#################################################################
+
+test_success()
@@ -0,0 +1,66 @@
+#
+# Tests the 'ulimit' and 'nice' keywords
+#
+# Checks that limits given in front of a command apply to that command
+# only, that 'ulimit' alone changes the shell's own limits, and that
+# 'nice' in front of a command lowers its priority.
+#
+import atexit, proc_check, time
+from testutils import *
+
+console = setup_tests()
+
+# ensure that shell prints expected prompt
+expect_prompt()
+
+#################################################################
+# 
+# Boilerplate ends here, now write your specific test.
+#
+#################################################################
+
+# Step 1. A limit in front of a command applies to that command
+#
+sendline("ulimit -S -n 32 grep files /proc/self/limits")
+expect(r"Max open files\s+32\s", "Expected the command to run with 32 open files")
+expect_prompt("Shell did not print expected prompt after ulimit")
+
+# Step 2. ... but not to the shell
+#
+sendline("ulimit -S -n")
+expect(r"(\d+|unlimited)\r\n", "Expected ulimit to print the shell's limit")
+assert console.match.group(1) != "32", "The shell's own limit was changed"
+expect_prompt("Shell did not print expected prompt after ulimit")
+
+# Step 3. ulimit alone changes the limits of the shell and later commands
+#
+sendline("ulimit -S -n 48")
+expect_prompt("Shell did not print expected prompt after ulimit")
+sendline("grep files /proc/self/limits")
+expect(r"Max open files\s+48\s", "Expected commands to inherit the shell's new limit")
+expect_prompt("Shell did not print expected prompt after grep")
+
+# Step 4. nice runs a command with a higher nice value
+#
+sendline("nice -n 5 cat /proc/self/stat")
+expect(r"\d+ \(cat\)(?: \S+){16} 5 ", "Expected cat to run with nice value 5")
+expect_prompt("Shell did not print expected prompt after nice")
+
+# Step 5. Options may be written as for nice(1) and sh's ulimit
+#
+sendline("nice -6 cat /proc/self/stat")
+expect(r"\d+ \(cat\)(?: \S+){16} 6 ", "Expected cat to run with nice value 6")
+expect_prompt("Shell did not print expected prompt after nice -6")
+sendline("ulimit -Sn 24 grep files /proc/self/limits")
+expect(r"Max open files\s+24\s", "Expected -Sn to set the soft limit")
+expect_prompt("Shell did not print expected prompt after ulimit -Sn")
+
+# Step 6. Options the shell does not know are left to the program
+#
+sendline("ionice -p 1 | tr a-z A-Z")
+expect(r"(NONE|BEST-EFFORT|IDLE|REALTIME)", "Expected ionice(1) to print the class of process 1")
+expect_prompt("Shell did not print expected prompt after ionice -p")
+
+#################################################################
+
+test_success()